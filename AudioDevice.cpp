@@ -0,0 +1,599 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+#include "AudioDevice.h"
+
+// a file "sound card" buffers this many periods before Write() blocks
+#define FILE_BUFFER_PERIODS 4
+
+std::unique_ptr<CAudioDevice> CAudioDevice::Open(const std::string &name, EAudioDirection dir, unsigned int rate, unsigned long period, const SAudioOptions &opts)
+{
+	std::unique_ptr<CAudioDevice> dev;
+	if (IsFile(name))
+		dev.reset(new CFileDevice(opts));
+	else
+		dev.reset(new CAlsaDevice(opts));
+	if (dev->Init(name, dir, rate, period))
+		dev.reset();
+	return dev;
+}
+
+short *CAudioDevice::Acquire(unsigned long frames)
+{
+	if (scratch.size() < frames)
+		scratch.resize(frames);
+	acquired = frames;
+	if (EAudioDirection::capture == direction) {
+		auto rc = Read(scratch.data(), frames);
+		if (rc < 0)
+			return nullptr;
+		if (rc < long(frames))
+			std::fill(scratch.begin() + rc, scratch.begin() + frames, 0);
+	}
+	return scratch.data();
+}
+
+long CAudioDevice::Release()
+{
+	if (EAudioDirection::playback == direction)
+		return Write(scratch.data(), acquired);
+	return long(acquired);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool CAlsaDevice::Init(const std::string &name, EAudioDirection dir, unsigned int rate, unsigned long period)
+{
+	direction = dir;
+	int rc = snd_pcm_open(&handle, name.c_str(), (EAudioDirection::capture == dir) ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK, 0);
+	if (rc < 0) {
+		std::cerr << "unable to open pcm device: " << snd_strerror(rc) << std::endl;
+		handle = nullptr;
+		return true;
+	}
+
+	// Allocate a hardware parameters object.
+	snd_pcm_hw_params_t *params;
+	snd_pcm_hw_params_alloca(&params);
+
+	// Fill it in with default values.
+	snd_pcm_hw_params_any(handle, params);
+
+	// Interleaved mode
+	if (mmap && snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_MMAP_INTERLEAVED) < 0) {
+		std::cerr << name << " can't be memory mapped, using read/write access" << std::endl;
+		mmap = false;
+	}
+	if (! mmap)
+		snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+
+	// Signed 16-bit little-endian format
+	snd_pcm_hw_params_set_format(handle, params, SND_PCM_FORMAT_S16_LE);
+
+	// One channels (mono)
+	snd_pcm_hw_params_set_channels(handle, params, 1);
+
+	snd_pcm_hw_params_set_rate(handle, params, rate, 0);
+	// the driver may not be able to do exactly what we want
+	snd_pcm_uframes_t psize = period;
+	int dir_near = 0;
+	snd_pcm_hw_params_set_period_size_near(handle, params, &psize, &dir_near);
+	if (periods) {
+		snd_pcm_uframes_t bsize = psize * std::min(std::max(periods, 2u), unsigned(MAX_BUFFER_PERIODS));
+		snd_pcm_hw_params_set_buffer_size_near(handle, params, &bsize);
+	}
+
+	// Write the parameters to the driver
+	rc = snd_pcm_hw_params(handle, params);
+	if (rc < 0) {
+		std::cerr << "unable to set hw parameters: " << snd_strerror(rc) << std::endl;
+		snd_pcm_close(handle);
+		handle = nullptr;
+		return true;
+	}
+	snd_pcm_uframes_t bsize = 0;
+	snd_pcm_hw_params_get_period_size(params, &psize, &dir_near);
+	snd_pcm_hw_params_get_buffer_size(params, &bsize);
+	if (psize != period || periods)
+		std::cout << name << " " << ((EAudioDirection::capture == dir) ? "capture" : "playback") << " period is " << psize << " frames and the buffer is " << bsize << " frames" << std::endl;
+
+	// wake up for every period, and only stop when the ring is completely empty or full
+	snd_pcm_sw_params_t *swparams;
+	snd_pcm_sw_params_alloca(&swparams);
+	snd_pcm_sw_params_current(handle, swparams);
+	snd_pcm_sw_params_set_avail_min(handle, swparams, psize);
+	snd_pcm_sw_params_set_stop_threshold(handle, swparams, bsize);
+	start_threshold = 0;
+	if (start && EAudioDirection::playback == dir) {
+		start_threshold = std::min(snd_pcm_uframes_t(start) * psize, bsize);
+		snd_pcm_sw_params_set_start_threshold(handle, swparams, start_threshold);
+	}
+	rc = snd_pcm_sw_params(handle, swparams);
+	if (rc < 0)
+		std::cerr << "unable to set sw parameters: " << snd_strerror(rc) << std::endl;
+	// a memory mapped capture device doesn't start by itself
+	if (mmap && EAudioDirection::capture == dir)
+		snd_pcm_start(handle);
+	return false;
+}
+
+// They're counted rather than printed here, this is on a real-time thread.
+bool CAlsaDevice::Recover(int err)
+{
+	if (-EPIPE == err)
+		xrun.xruns++;
+	else if (-ESTRPIPE != err) {
+		xrun.errors++;
+		xrun.lasterror = snd_strerror(err);
+	}
+	const auto start = std::chrono::steady_clock::now();
+	err = snd_pcm_recover(handle, err, 1);
+	if (err < 0) {
+		xrun.errors++;
+		xrun.lasterror = snd_strerror(err);
+		return true;
+	}
+	if (EAudioDirection::capture == direction)
+		snd_pcm_start(handle);
+	const std::chrono::duration<double, std::micro> took(std::chrono::steady_clock::now() - start);
+	xrun.AddRecovery(took.count());
+	return false;
+}
+
+// what didn't get moved
+long CAlsaDevice::Tally(long rc, unsigned long frames)
+{
+	if (rc < 0) {
+		xrun.dropped += frames;
+		if (-EPIPE != rc && -ESTRPIPE != rc) {
+			xrun.errors++;
+			xrun.lasterror = snd_strerror(int(rc));
+		}
+	} else if ((unsigned long)rc < frames) {
+		xrun.shorts++;
+		xrun.dropped += frames - rc;
+	}
+	return rc;
+}
+
+// wait until there's room for, or data for, this many frames
+bool CAlsaDevice::WaitAvail(unsigned long frames)
+{
+	while (true) {
+		auto avail = snd_pcm_avail_update(handle);
+		if (avail < 0) {
+			if (Recover(int(avail)))
+				return true;
+			continue;
+		}
+		if ((unsigned long)avail >= frames)
+			return false;
+		if (EAudioDirection::playback == direction && SND_PCM_STATE_PREPARED == snd_pcm_state(handle))
+			snd_pcm_start(handle);	// the buffer is full, so it's time to start playing, whatever the threshold is
+		auto rc = snd_pcm_wait(handle, 1000);
+		if (rc < 0 && Recover(rc))
+			return true;
+	}
+}
+
+// frames is how many we want, and comes back with how many are contiguous in the ring
+short *CAlsaDevice::Begin(snd_pcm_uframes_t &frames)
+{
+	const snd_pcm_channel_area_t *areas;
+	auto rc = snd_pcm_mmap_begin(handle, &areas, &offset, &frames);
+	if (rc < 0) {
+		xrun.errors++;
+		xrun.lasterror = snd_strerror(rc);
+		return nullptr;
+	}
+	return (short *)((char *)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8);
+}
+
+bool CAlsaDevice::Commit(snd_pcm_uframes_t frames)
+{
+	auto rc = snd_pcm_mmap_commit(handle, offset, frames);
+	if (rc < 0 || (snd_pcm_uframes_t)rc != frames) {
+		Recover((rc < 0) ? int(rc) : -EPIPE);
+		return true;
+	}
+	return false;
+}
+
+short *CAlsaDevice::Acquire(unsigned long frames)
+{
+	if (! mmap)
+		return CAudioDevice::Acquire(frames);
+	acquired = 0;
+	direct = false;
+	if (WaitAvail(frames)) {
+		xrun.dropped += frames;
+		return nullptr;
+	}
+	snd_pcm_uframes_t count = frames;
+	auto p = Begin(count);
+	if (nullptr == p) {
+		xrun.dropped += frames;	// Begin() counted the error
+		return nullptr;
+	}
+	acquired = frames;
+	direct = (count == frames);
+	if (direct)
+		return p;	// the usual case, no copy at all
+
+	// the ring wraps around in the middle of our frames
+	if (scratch.size() < frames)
+		scratch.resize(frames);
+	if (EAudioDirection::capture == direction) {
+		// copy both pieces out now and give them back
+		unsigned long done = 0;
+		while (p) {
+			memcpy(scratch.data() + done, p, count * sizeof(short));
+			done += count;
+			if (Commit(count))
+				break;
+			if (done == frames)
+				break;
+			count = frames - done;
+			p = Begin(count);
+		}
+		if (done < frames) {
+			Tally(long(done), frames);
+			acquired = 0;
+			return nullptr;
+		}
+	} else {
+		Commit(0);
+	}
+	return scratch.data();
+}
+
+long CAlsaDevice::Release()
+{
+	if (! mmap)
+		return CAudioDevice::Release();
+	if (0 == acquired)
+		return -EIO;	// Acquire() failed, and it's already been counted
+	if (direct) {
+		if (Commit(acquired))
+			return Tally(-EPIPE, acquired);
+	} else if (EAudioDirection::playback == direction) {
+		// copy the scratch buffer into the ring, a piece at a time
+		unsigned long done = 0;
+		while (done < acquired) {
+			snd_pcm_uframes_t count = acquired - done;
+			auto p = Begin(count);
+			if (nullptr == p)
+				return Tally(-EIO, acquired - done);
+			memcpy(p, scratch.data() + done, count * sizeof(short));
+			if (Commit(count))
+				return Tally(-EPIPE, acquired - done);
+			done += count;
+		}
+	}
+	// playback starts when there's a period in the buffer, unless it's been told to wait for more
+	if (0 == start_threshold && EAudioDirection::playback == direction && SND_PCM_STATE_PREPARED == snd_pcm_state(handle))
+		snd_pcm_start(handle);
+	return long(acquired);
+}
+
+// After an overrun or a suspend the device is recovered and the read is tried
+// once more, so the caller usually gets its period, only later than it wanted.
+long CAlsaDevice::Read(short *buf, unsigned long frames)
+{
+	auto rc = snd_pcm_readi(handle, buf, frames);
+	if ((-EPIPE == rc || -ESTRPIPE == rc) && ! Recover(int(rc)))
+		rc = snd_pcm_readi(handle, buf, frames);
+	return Tally(rc, frames);
+}
+
+// the same for an underrun, what we were about to write starts the device again
+long CAlsaDevice::Write(const short *buf, unsigned long frames)
+{
+	auto rc = snd_pcm_writei(handle, buf, frames);
+	if ((-EPIPE == rc || -ESTRPIPE == rc) && ! Recover(int(rc)))
+		rc = snd_pcm_writei(handle, buf, frames);
+	return Tally(rc, frames);
+}
+
+long CAlsaDevice::Delay()
+{
+	snd_pcm_sframes_t delay = 0;
+	if (snd_pcm_delay(handle, &delay) < 0 || delay < 0)
+		return 0;
+	return delay;
+}
+
+void CAlsaDevice::Close(bool drain)
+{
+	if (handle) {
+		if (drain)
+			snd_pcm_drain(handle);
+		else
+			snd_pcm_drop(handle);
+		snd_pcm_close(handle);
+		handle = nullptr;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+static uint32_t Get32(const unsigned char *p)
+{
+	return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+static uint16_t Get16(const unsigned char *p)
+{
+	return uint16_t(p[0]) | (uint16_t(p[1]) << 8);
+}
+
+static void Put32(unsigned char *p, uint32_t v)
+{
+	for (int i=0; i<4; i++)
+		p[i] = (v >> (8 * i)) & 0xffu;
+}
+
+static void Put16(unsigned char *p, uint16_t v)
+{
+	p[0] = v & 0xffu;
+	p[1] = v >> 8;
+}
+
+static bool HasWavExtension(const std::string &path)
+{
+	return path.size() > 4 && 0 == strcasecmp(path.c_str() + path.size() - 4, ".wav");
+}
+
+bool CFileDevice::Init(const std::string &name, EAudioDirection dir, unsigned int rate, unsigned long period)
+{
+	path.assign(name.substr(5));
+	direction = dir;
+	samplerate = rate;
+	periodsize = period;
+	at_end = false;
+	written = 0;
+	data_end = -1;
+	if (EAudioDirection::capture == dir) {
+		file = fopen(path.c_str(), "rb");
+		if (nullptr == file) {
+			std::cerr << "unable to open audio file " << path << ": " << strerror(errno) << std::endl;
+			return true;
+		}
+		// anything that doesn't start with a RIFF header is raw audio
+		unsigned char riff[4];
+		is_wav = (4 == fread(riff, 1, 4, file) && 0 == memcmp(riff, "RIFF", 4));
+		if (is_wav) {
+			if (ReadWavHeader()) {
+				fclose(file);
+				file = nullptr;
+				return true;
+			}
+		} else {
+			data_start = 0;
+			fseek(file, 0, SEEK_SET);
+		}
+	} else {
+		is_wav = HasWavExtension(path);
+		if (is_wav) {
+			if (OpenWavOutput())
+				return true;
+		} else {
+			// raw output is appended, so each received stream adds to the file
+			file = fopen(path.c_str(), "ab");
+			if (nullptr == file) {
+				std::cerr << "unable to open audio file " << path << ": " << strerror(errno) << std::endl;
+				return true;
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	return false;
+}
+
+bool CFileDevice::ReadWavHeader()
+{
+	unsigned char buf[16];
+	if (8 != fread(buf, 1, 8, file) || memcmp(buf+4, "WAVE", 4)) {
+		std::cerr << path << " is not a WAV file" << std::endl;
+		return true;
+	}
+	bool have_fmt = false;
+	while (8 == fread(buf, 1, 8, file)) {
+		const uint32_t size = Get32(buf+4);
+		if (0 == memcmp(buf, "fmt ", 4)) {
+			if (size < 16 || 16 != fread(buf, 1, 16, file)) {
+				std::cerr << path << " has a bad fmt chunk" << std::endl;
+				return true;
+			}
+			if (1u != Get16(buf) || 1u != Get16(buf+2) || samplerate != Get32(buf+4) || 16u != Get16(buf+14)) {
+				std::cerr << path << " must be 16-bit PCM, mono, " << samplerate << " samples/sec" << std::endl;
+				return true;
+			}
+			have_fmt = true;
+			fseek(file, long(size - 16 + (size & 1u)), SEEK_CUR);
+		} else if (0 == memcmp(buf, "data", 4)) {
+			if (! have_fmt) {
+				std::cerr << path << " has no fmt chunk before its data" << std::endl;
+				return true;
+			}
+			data_start = ftell(file);
+			// anything after the data, like a LIST or id3 chunk, isn't audio
+			// a streamed WAV may not know its size, so then it's read to the end
+			if (size > 0u && size < 0xffffffffu)
+				data_end = data_start + long(size & ~1u);
+			return false;
+		} else {
+			// skip anything else, chunks are padded to an even size
+			fseek(file, long(size + (size & 1u)), SEEK_CUR);
+		}
+	}
+	std::cerr << path << " has no data chunk" << std::endl;
+	return true;
+}
+
+bool CFileDevice::OpenWavOutput()
+{
+	// if there's already a WAV file like ours, each received stream is added to it
+	file = fopen(path.c_str(), "r+b");
+	if (file) {
+		unsigned char hdr[44];
+		if (44 == fread(hdr, 1, 44, file) && 0 == memcmp(hdr, "RIFF", 4) && 0 == memcmp(hdr+8, "WAVEfmt ", 8) && 0 == memcmp(hdr+36, "data", 4) && 1u == Get16(hdr+22) && samplerate == Get32(hdr+24) && 16u == Get16(hdr+34)) {
+			fseek(file, 0, SEEK_END);
+			data_start = 44;
+			return false;
+		}
+		fclose(file);
+	}
+	file = fopen(path.c_str(), "w+b");
+	if (nullptr == file) {
+		std::cerr << "unable to open audio file " << path << ": " << strerror(errno) << std::endl;
+		return true;
+	}
+	unsigned char hdr[44];
+	memcpy(hdr, "RIFF", 4);
+	Put32(hdr+4, 36u);
+	memcpy(hdr+8, "WAVEfmt ", 8);
+	Put32(hdr+16, 16u);				// fmt chunk size
+	Put16(hdr+20, 1u);				// PCM
+	Put16(hdr+22, 1u);				// mono
+	Put32(hdr+24, samplerate);
+	Put32(hdr+28, 2u * samplerate);	// bytes per second
+	Put16(hdr+32, 2u);				// bytes per frame
+	Put16(hdr+34, 16u);				// bits per sample
+	memcpy(hdr+36, "data", 4);
+	Put32(hdr+40, 0u);
+	fwrite(hdr, 1, 44, file);
+	data_start = 44;
+	return false;
+}
+
+void CFileDevice::UpdateWavHeader()
+{
+	fflush(file);
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	unsigned char buf[4];
+	Put32(buf, uint32_t(size - 8));
+	fseek(file, 4, SEEK_SET);
+	fwrite(buf, 1, 4, file);
+	Put32(buf, uint32_t(size - data_start));
+	fseek(file, 40, SEEK_SET);
+	fwrite(buf, 1, 4, file);
+	fseek(file, 0, SEEK_END);
+}
+
+// sleep until the moment a real sound card would have played, or recorded, this many frames
+void CFileDevice::SleepUntil(unsigned long long frames) const
+{
+	const unsigned long long ns = frames * 1000000000ull / samplerate;
+	struct timespec when;
+	when.tv_sec = start.tv_sec + time_t(ns / 1000000000ull);
+	when.tv_nsec = start.tv_nsec + long(ns % 1000000000ull);
+	if (when.tv_nsec >= 1000000000l) {
+		when.tv_sec++;
+		when.tv_nsec -= 1000000000l;
+	}
+	while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, nullptr))
+		;
+}
+
+// how many frames a real sound card would still have in its buffer
+long CFileDevice::Queued() const
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	const long long elapsed = (now.tv_sec - start.tv_sec) * 1000000000ll + (now.tv_nsec - start.tv_nsec);
+	const long long played = elapsed * samplerate / 1000000000ll;
+	return (played >= (long long)written) ? 0 : long(written - played);
+}
+
+long CFileDevice::Read(short *buf, unsigned long frames)
+{
+	if (nullptr == file || EAudioDirection::capture != direction)
+		return -EBADF;
+	if (options.paced)
+		SleepUntil(written + frames);
+	written += frames;
+	unsigned long count = 0;
+	while (count < frames) {
+		unsigned long want = frames - count;
+		if (data_end >= 0) {
+			const long left = (data_end - ftell(file)) / long(sizeof(short));
+			want = (left > 0) ? std::min(want, (unsigned long)left) : 0ul;
+		}
+		const auto got = want ? fread(buf + count, sizeof(short), want, file) : 0ul;
+		count += got;
+		if (count < frames) {
+			if (options.loop && ftell(file) > data_start) {
+				fseek(file, data_start, SEEK_SET);
+			} else {
+				// pad the last period with silence
+				memset(buf + count, 0, (frames - count) * sizeof(short));
+				at_end = true;
+				break;
+			}
+		}
+	}
+	return long(frames);
+}
+
+long CFileDevice::Write(const short *buf, unsigned long frames)
+{
+	if (nullptr == file || EAudioDirection::playback != direction)
+		return -EBADF;
+	if (options.paced) {
+		if (0 == Queued()) {
+			// the "sound card" ran dry, so restart the clock like an underrun would
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			written = 0;
+		}
+		// block while the buffer is full, like snd_pcm_writei() would
+		if (written + frames > FILE_BUFFER_PERIODS * periodsize)
+			SleepUntil(written + frames - FILE_BUFFER_PERIODS * periodsize);
+	}
+	written += frames;
+	const auto count = fwrite(buf, sizeof(short), frames, file);
+	if (count < frames)
+		std::cerr << "error writing audio file " << path << ": " << strerror(errno) << std::endl;
+	return long(count);
+}
+
+long CFileDevice::Delay()
+{
+	return options.paced ? Queued() : 0;
+}
+
+void CFileDevice::Close(bool drain)
+{
+	if (file) {
+		if (EAudioDirection::playback == direction) {
+			if (drain && options.paced)
+				SleepUntil(written);
+			if (is_wav)
+				UpdateWavHeader();
+		}
+		fclose(file);
+		file = nullptr;
+	}
+}
@@ -0,0 +1,147 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <memory>
+#include <vector>
+
+#define ALSA_PCM_NEW_HW_PARAMS_API
+#include <alsa/asoundlib.h>
+
+#include "Latency.h"
+
+enum class EAudioDirection { capture, playback };
+
+using SAudioOptions = struct audiooptions_tag
+{
+	bool paced;	// files: read and write at the sample rate, like a sound card would
+	bool loop;	// files: start over at the end of the input file
+	bool mmap;	// ALSA: work directly in the sound card's ring buffer
+	unsigned int periods;	// ALSA: the ring buffer size in periods, zero leaves it to the driver
+	unsigned int start;		// ALSA playback: start when this many periods are queued, zero leaves it to the driver
+};
+
+// the most periods a sound card buffer can be set to
+#define MAX_BUFFER_PERIODS 16
+
+// Where the audio manager gets its 16-bit mono samples from and sends them to.
+// The device name is either an ALSA pcm name, or "file:" followed by the path
+// to a WAV or raw S16_LE file.
+class CAudioDevice
+{
+public:
+	CAudioDevice() : direction(EAudioDirection::capture), acquired(0) { xrun.Clear(); }
+	virtual ~CAudioDevice() {}
+	// returns nullptr on failure
+	static std::unique_ptr<CAudioDevice> Open(const std::string &name, EAudioDirection dir, unsigned int rate, unsigned long period, const SAudioOptions &opts);
+	static bool IsFile(const std::string &name) { return 0 == name.compare(0, 5, "file:"); }
+
+	// these return the number of frames, or a negative error, just like snd_pcm_readi() and snd_pcm_writei()
+	virtual long Read(short *buf, unsigned long frames) = 0;
+	virtual long Write(const short *buf, unsigned long frames) = 0;
+	// Zero-copy access to the device buffer. Acquire() returns room for the frames
+	// to be read from (capture) or filled in (playback) and Release() hands them
+	// back, returning the number of frames or a negative error. Acquire() returns
+	// nullptr on failure. Devices that can't do this use a scratch buffer.
+	virtual short *Acquire(unsigned long frames);
+	virtual long Release();
+	// frames written but not yet heard
+	virtual long Delay() = 0;
+	// the input has run out
+	virtual bool AtEnd() const { return false; }
+	// let playback finish if drain is true, otherwise throw away what's queued
+	virtual void Close(bool drain) = 0;
+	// overruns or underruns since it was opened
+	unsigned int GetXruns() const { return xrun.xruns; }
+	const SXrunStats &GetXrunStats() const { return xrun; }
+
+protected:
+	EAudioDirection direction;
+	std::vector<short> scratch;
+	unsigned long acquired;
+	SXrunStats xrun;
+
+	virtual bool Init(const std::string &name, EAudioDirection dir, unsigned int rate, unsigned long period) = 0;
+};
+
+class CAlsaDevice : public CAudioDevice
+{
+public:
+	CAlsaDevice(const SAudioOptions &opts) : handle(nullptr), mmap(opts.mmap), offset(0), direct(false), periods(opts.periods), start(opts.start), start_threshold(0) {}
+	~CAlsaDevice() { Close(false); }
+	long Read(short *buf, unsigned long frames);
+	long Write(const short *buf, unsigned long frames);
+	short *Acquire(unsigned long frames);
+	long Release();
+	long Delay();
+	void Close(bool drain);
+
+protected:
+	bool Init(const std::string &name, EAudioDirection dir, unsigned int rate, unsigned long period);
+
+private:
+	snd_pcm_t *handle;
+	bool mmap;
+	snd_pcm_uframes_t offset;	// of the acquired frames in the ring
+	bool direct;				// the acquired frames are in the ring, not in the scratch buffer
+	unsigned int periods, start;
+	snd_pcm_uframes_t start_threshold;	// zero if it was left to the driver
+
+	bool WaitAvail(unsigned long frames);
+	short *Begin(snd_pcm_uframes_t &frames);
+	bool Commit(snd_pcm_uframes_t frames);
+	bool Recover(int err);
+	long Tally(long rc, unsigned long frames);
+};
+
+class CFileDevice : public CAudioDevice
+{
+public:
+	CFileDevice(const SAudioOptions &opts) : options(opts), file(nullptr), is_wav(false), at_end(false), data_start(0), data_end(-1), written(0) {}
+	~CFileDevice() { Close(false); }
+	long Read(short *buf, unsigned long frames);
+	long Write(const short *buf, unsigned long frames);
+	long Delay();
+	bool AtEnd() const { return at_end; }
+	void Close(bool drain);
+
+protected:
+	bool Init(const std::string &name, EAudioDirection dir, unsigned int rate, unsigned long period);
+
+private:
+	SAudioOptions options;
+	std::string path;
+	FILE *file;
+	unsigned int samplerate;
+	unsigned long periodsize;
+	bool is_wav, at_end;
+	long data_start;
+	long data_end;	// where a WAV file's data chunk stops, -1 reads to the end of the file
+	unsigned long long written;	// frames since the pacing clock started
+	struct timespec start;
+
+	bool ReadWavHeader();
+	bool OpenWavOutput();
+	void UpdateWavHeader();
+	long Queued() const;
+	void SleepUntil(unsigned long long frames) const;
+};
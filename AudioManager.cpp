@@ -16,25 +16,27 @@
  *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
-#define ALSA_PCM_NEW_HW_PARAMS_API
-#include <alsa/asoundlib.h>
 #include <netinet/in.h>
 
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 
 #include "MainWindow.h"
 #include "AudioManager.h"
 #include "Configure.h"
 #include "FrameType.h"
 #include "Callsign.h"
+#include "Latency.h"
+#include "Drift.h"
 #include "codec2.h"
 
-CAudioManager::CAudioManager() : hot_mic(false), play_file(false), m17_sid_in(0U)
+CAudioManager::CAudioManager() : hot_mic(false), play_file(false), tuning(false), tune_stop(false), tx_started(false), rx_preempt(false), replay_stop(false), rx_busy(false), mixing(false), heard(false), pending_key(0U), record_rx(false), record_tx(false), capture_ppm(0.0), no_pace(false), loop_file(false), AM2M17(nullptr)
 {
 	link_open = true;
-	volStats.count = 0;
 
 #ifdef USE44100
 	expand.data_in = expand_in;
@@ -56,11 +58,185 @@ CAudioManager::CAudioManager() : hot_mic(false), play_file(false), m17_sid_in(0U
 bool CAudioManager::Init(CMainWindow *pMain)
 {
 	pMainWindow = pMain;
-	AM2M17.SetUp("am2m17");
-	LogInput.SetUp("log_input");
+	AM2M17 = &pMainWindow->AM2M17;
+	auto pcfg = pMainWindow->cfg.GetData();
+	const auto pol = pcfg->eRTPolicy;
+	const auto pri = pcfg->iAudioPriority;
+	const auto cpu = pcfg->iAudioCPU;
+	if (capture.Start("mv-capture", pol, pri, cpu) || encode.Start("mv-encode", pol, pri, cpu) || packetize.Start("mv-packetize", pol, pri, cpu) || decode.Start("mv-decode", pol, pri, cpu) || playback.Start("mv-playback", pol, pri, cpu))
+		return true;
+	echo.Init(pcfg->iEchoSeconds);
+	// a lane for each stream we can hear at once
+	int streams = pcfg->iRXStreams;
+	if (streams < 1)
+		streams = 1;
+	else if (streams > MAX_RX_STREAMS)
+		streams = MAX_RX_STREAMS;
+	// the lanes' gains in dB, a lane that isn't in the list is at unity
+	const char *gains = pcfg->sRXGains.c_str();
+	for (int i=0; i<streams; i++) {
+		lanes.emplace_back(new SRXLane);
+		auto lane = lanes.back().get();
+		lane->key = 0U;
+		lane->slot = -1;
+		lane->number = unsigned(i);
+		char *end = nullptr;
+		const double db = strtod(gains, &end);
+		lane->gain = (end == gains) ? 1.0f : float(std::pow(10.0, std::min(std::max(db, -40.0), 12.0) / 20.0));
+		gains = (',' == *end) ? end + 1 : end;
+		if (lane->decode.Start("mv-rx" + std::to_string(i+1), pol, pri, cpu))
+			return true;
+	}
+	replay.Init(pcfg->iReplayMinutes > 0 ? pcfg->iReplayMinutes : 0, unsigned(streams));
+	// the archive isn't worth failing for
+	if ((pcfg->bRecordRX || pcfg->bRecordTX) && ! recorder.Start(pcfg->sRecordPath, pcfg->bRecordWAV)) {
+		record_rx = pcfg->bRecordRX;
+		record_tx = pcfg->bRecordTX;
+	}
 	return false;
 }
 
+void CAudioManager::SetAudioDevices(const std::string &in, const std::string &out, bool nopace, bool loop)
+{
+	audio_in.assign(in);
+	audio_out.assign(out);
+	no_pace = nopace;
+	loop_file = loop;
+}
+
+SAudioOptions CAudioManager::DeviceOptions(EAudioDirection dir)
+{
+	auto data = pMainWindow->cfg.GetData();
+	SAudioOptions opts;
+	opts.paced = data->bAudioFilePaced && ! no_pace;
+	opts.loop = data->bAudioFileLoop || loop_file;
+	opts.mmap = data->bAudioMMap;
+	const int periods = (EAudioDirection::capture == dir) ? data->iAudioInPeriods : data->iAudioOutPeriods;
+	opts.periods = (periods > 0) ? unsigned(periods) : 0u;
+	opts.start = (EAudioDirection::playback == dir && data->iAudioStartPeriods > 0) ? unsigned(data->iAudioStartPeriods) : 0u;
+	return opts;
+}
+
+// Plays or records a few seconds at each buffer size, starting with the smallest,
+// until there are no xruns. It's done on the stage's own thread, so the scheduling
+// is just like it will be, and the device is worked like the pipeline works it:
+// what's captured is encoded every 40 ms, and playback gets a codec 2 frame decoded
+// and written every 40 ms, behind the same two period lead play_audio() uses.
+// Returns zero if the device couldn't be opened or the tuning was stopped.
+int CAudioManager::TuneDevice(const std::string &device, EAudioDirection dir)
+{
+	if (CAudioDevice::IsFile(device))
+		return 0;
+#ifdef USE44100
+	const unsigned int rate = 44100u;
+	const unsigned long frames = 882u;
+#else
+	const unsigned int rate = 8000u;
+	const unsigned long frames = 160u;
+#endif
+	const char *what = (EAudioDirection::capture == dir) ? "input" : "output";
+	const bool playback = (EAudioDirection::playback == dir);
+	const bool is_3200 = pMainWindow->cfg.GetData()->bVoiceOnlyEnable;
+	CCodec2 c2(is_3200);
+	unsigned char bits[16] = { 0 };
+	short audio[320] = { 0 };
+	auto opts = DeviceOptions(dir);
+	for (unsigned int periods=2u; periods<=MAX_BUFFER_PERIODS; periods++) {
+		opts.periods = opts.start = periods;
+		auto dev = CAudioDevice::Open(device, dir, rate, frames, opts);
+		if (! dev)
+			return 0;
+		CFrameClock clock(40u);
+		if (playback) {
+			WriteSilence(dev.get(), frames, 2);
+			clock.Start(40u);
+		}
+		for (unsigned int i=0u; i<TUNE_PERIODS && ! tune_stop; i+=2u) {
+			if (playback) {
+				// the decode stage's work for each frame, the result isn't played, it's only the load
+				clock.Wait();
+				c2.codec2_decode(audio, bits);
+				if (is_3200)
+					c2.codec2_decode(audio+160, bits+8);
+			}
+			bool failed = false;
+			for (unsigned int n=0u; n<2u; n++) {
+				auto buf = dev->Acquire(frames);
+				if (nullptr == buf) {
+					failed = true;
+					break;
+				}
+				if (playback)
+					memset(buf, 0, frames * sizeof(short));
+				else
+					memcpy(audio+160*n, buf, 160 * sizeof(short));
+				dev->Release();
+			}
+			if (failed)
+				break;
+			if (! playback) {
+				c2.codec2_encode(bits, audio);
+				if (is_3200)
+					c2.codec2_encode(bits+8, audio+160);
+			}
+		}
+		const auto xruns = dev->GetXruns();
+		dev->Close(tune_stop);
+		if (tune_stop) {
+			SendLog("Tuning %s %s was stopped by a received stream\n", what, device.c_str());
+			return 0;
+		}
+		SendLog("Tuning %s %s: %u periods had %u xruns\n", what, device.c_str(), periods, xruns);
+		if (0u == xruns)
+			return std::min(periods + 1u, unsigned(MAX_BUFFER_PERIODS));	// with a period to spare
+	}
+	return MAX_BUFFER_PERIODS;
+}
+
+bool CAudioManager::AutoTune(const std::string &in, const std::string &out, std::function<void(int, int)> done)
+{
+	if (hot_mic || tuning)
+		return true;
+	{
+		std::lock_guard<std::mutex> lck(stream_mtx);
+		if (mixing)
+			return true;
+		tune_stop = false;
+		tuning = true;	// nothing new will be played or sent
+	}
+	// one after the other, each on the thread that will use it
+	if (capture.Run([this, in, out, done]{
+		const int inperiods = TuneDevice(in, EAudioDirection::capture);
+		if (tune_stop) {
+			EndTuning();
+			done(inperiods, 0);
+			return;
+		}
+		if (playback.Run([this, out, inperiods, done]{
+			const int outperiods = TuneDevice(out, EAudioDirection::playback);
+			EndTuning();
+			done(inperiods, outperiods);
+		})) {
+			SendLog("The playback thread is busy, the output device wasn't tuned\n");
+			EndTuning();
+			done(inperiods, 0);
+		}
+	})) {
+		tuning = false;
+		return true;
+	}
+	return false;
+}
+
+// the stream that stopped the tuning, if there was one, is started now that the sound card is free
+void CAudioManager::EndTuning()
+{
+	std::lock_guard<std::mutex> lck(stream_mtx);
+	tuning = false;
+	if (! pending.empty())
+		StartPending(lanes[0].get());
+}
+
 void CAudioManager::BuildMetaBlocks()
 {
 	auto pcfg = pMainWindow->cfg.GetData();
@@ -71,47 +247,265 @@ void CAudioManager::BuildMetaBlocks()
 	CMessage::MakeBlocks(pcfg->sMessage, msgblks);
 }
 
-void CAudioManager::RecordMicThread(E_PTT_Type for_who, const std::string &urcall)
+bool CAudioManager::RecordMicThread(E_PTT_Type for_who, const std::string &urcall)
 {
-	// wait on audio queue to empty
+	if (tuning)
+		return true;	// the sound card is being tuned
+	auto data = pMainWindow->cfg.GetData();
+	hot_mic = true;
+	tx_started = false;
 
-	unsigned int count = 0u;
-	while (! audio_queue.IsEmpty()) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(20));
-		count++;
+	const bool is_3200 = data->bVoiceOnlyEnable;
+	const bool is_m17 = (for_who == E_PTT_Type::m17);
+	const std::string src(data->sM17SourceCallsign);
+	// the capture thread waits for any received audio to finish, so the GUI doesn't have to
+	if (capture.Run([this, is_m17, urcall, src, is_3200]{
+		WaitRXDrained();
+		if (! hot_mic)
+			return;	// the PTT was released before we got started
+		tx_started = true;
+		std::function<void()> packetizer;
+		if (is_m17)
+			packetizer = [this, urcall, src, is_3200]{ codec2gateway(urcall, src, is_3200); };
+		else
+			packetizer = [this, is_3200]{ codec2echo(is_3200); };
+		if (StartTXStages(true, is_3200, std::move(packetizer))) {
+			tx_started = false;
+			hot_mic = false;
+			return;
+		}
+		mic2audio(audio_in.empty() ? pMainWindow->cfg.GetData()->sAudioIn : audio_in, DeviceOptions(EAudioDirection::capture));
+	})) {
+		SendLog("The capture thread is busy, try again\n");
+		hot_mic = false;
+		return true;
+	}
+	return false;
+}
+
+// On the capture thread. The encoder, if it's used, is started first, then
+// the packetizer. Returns true if either one couldn't be started, and then
+// neither one is left running.
+bool CAudioManager::StartTXStages(bool use_encoder, bool is_3200, std::function<void()> packetizer)
+{
+	if (use_encoder && encode.Run([this, is_3200]{ audio2codec(is_3200); })) {
+		SendLog("The encoder is still busy, nothing was sent\n");
+		return true;
+	}
+	if (packetize.Run(std::move(packetizer))) {
+		SendLog("The packetizer is still busy, nothing was sent\n");
+		if (use_encoder) {
+			// let the encoder finish, and throw away what it made
+			CAudioFrame frame;
+			frame.SetFlag(true);
+			audio_queue.Push(frame);
+			encode.Wait();
+			c2_queue.Clear();
+		}
+		return true;
 	}
-	if (count > 0)
-		std::cout << "Tailgating detected! Waited " << count*20 << " ms for audio queue to clear." << std::endl;
+	return false;
+}
 
+bool CAudioManager::TransmitFile(const std::string &path, const std::string &urcall, std::function<void()> done)
+{
+	if (tuning)
+		return true;
 	auto data = pMainWindow->cfg.GetData();
+	bool is_3200 = data->bVoiceOnlyEnable;
+	FILE *fp = nullptr;
+	// a .c2 file is already encoded, anything else goes to the file audio device
+	if (path.size() > 3 && 0 == path.compare(path.size() - 3, 3, ".c2")) {
+		fp = fopen(path.c_str(), "rb");
+		if (nullptr == fp) {
+			std::cerr << "Can't open " << path << ": " << strerror(errno) << std::endl;
+			return true;
+		}
+		// c2enc writes a header with the codec2 mode, but a raw file might not have one
+		uint8_t header[7];
+		if (7u == fread(header, 1, 7, fp) && 0xc0u == header[0] && 0xdeu == header[1] && 0xc2u == header[2]) {
+			if (0u == header[5] || 2u == header[5]) {
+				is_3200 = (0u == header[5]);
+			} else {
+				std::cerr << path << " is codec2 mode " << int(header[5]) << ", M17 can only use 3200 or 1600" << std::endl;
+				fclose(fp);
+				return true;
+			}
+		} else
+			rewind(fp);
+		const auto start = ftell(fp);
+		fseek(fp, 0, SEEK_END);
+		if (ftell(fp) - start < 8) {
+			std::cerr << path << " doesn't have any codec2 data" << std::endl;
+			fclose(fp);
+			return true;
+		}
+		fseek(fp, start, SEEK_SET);
+	}
+
 	hot_mic = true;
+	play_file = true;
+	tx_started = false;
+	const std::string src(data->sM17SourceCallsign);
+	if (capture.Run([this, path, urcall, src, is_3200, fp, done]{
+		WaitRXDrained();
+		if (hot_mic) {
+			tx_started = true;
+			// the file is read a little ahead and the packets go out on the frame clock
+			CFrameClock clock(40u);
+			if (StartTXStages(nullptr == fp, is_3200, [this, urcall, src, is_3200, &clock]{ codec2gateway(urcall, src, is_3200, &clock); })) {
+				tx_started = false;
+			} else if (fp) {
+				c2file2codec(fp, is_3200);
+			} else {
+				SAudioOptions opts;
+				opts.paced = true;
+				opts.loop = opts.mmap = false;
+				opts.periods = opts.start = 0u;
+				mic2audio(std::string("file:") + path, opts);
+			}
+			if (tx_started) {
+				encode.Wait();
+				packetize.Wait();
+				const auto &stats = clock.GetStats();
+				SendLog("TX file pacing us: frames=%u late avg=%.0f max=%.0f\n", stats.count, stats.Average(), stats.max);
+			}
+		}
+		if (fp)
+			fclose(fp);
+		hot_mic = false;
+		play_file = false;
+		done();
+	})) {
+		SendLog("The capture thread is busy, the file wasn't sent\n");
+		if (fp)
+			fclose(fp);
+		hot_mic = false;
+		play_file = false;
+		return true;
+	}
+	return false;
+}
+
+// read an encoded file as fast as the codec would make it
+void CAudioManager::c2file2codec(FILE *fp, bool is_3200)
+{
+	const uint8_t quiet[] = { 0x00u, 0x01u, 0x43u, 0x09u, 0xe4u, 0x9cu, 0x08u, 0x21u };	// for 3200 only!
+	CFrameClock clock(is_3200 ? 20u : 40u);
+	uint8_t data[8], next[8];
+	// TransmitFile() made sure there is at least one frame
+	bool more = (8u == fread(data, 1, 8, fp));
+	bool last, is_odd = false;
+	do {
+		clock.Wait();
+		if (more)
+			more = hot_mic && (8u == fread(next, 1, 8, fp));
+		last = ! more;
+		is_odd = ! is_odd;
+		const auto now = CLatency::Now();
+		CC2DataFrame frame(data);
+		frame.SetStamps(now, now);
+		if (is_3200 && is_odd && last) {
+			// we need an even number of data frames for 3200
+			c2_queue.Push(frame);
+			CC2DataFrame frame2(quiet);
+			frame2.SetFlag(true);
+			frame2.SetStamps(now, now);
+			c2_queue.Push(frame2);
+		} else {
+			frame.SetFlag(last);
+			c2_queue.Push(frame);
+		}
+		memcpy(data, next, 8);
+	} while (! last);
+}
 
-	mic2audio_fut = std::async(std::launch::async, &CAudioManager::mic2audio, this);
+// called before the decode and playback stages are started
+void CAudioManager::StartRX()
+{
+	std::lock_guard<std::mutex> lck(rx_mtx);
+	rx_busy = true;
+	rx_preempt = false;
+}
 
-	audio2codec_fut = std::async(std::launch::async, &CAudioManager::audio2codec, this, data->bVoiceOnlyEnable);
+// called by the playback stage when it's done
+void CAudioManager::RXDrained()
+{
+	std::lock_guard<std::mutex> lck(rx_mtx);
+	rx_busy = false;
+	rx_preempt = false;
+	rx_cv.notify_all();
+}
 
-	if (for_who == E_PTT_Type::m17) {
-		codec2gateway_fut = std::async(std::launch::async, &CAudioManager::codec2gateway, this, urcall, data->sM17SourceCallsign, data->bVoiceOnlyEnable);
+void CAudioManager::WaitRXDrained()
+{
+	std::unique_lock<std::mutex> lck(rx_mtx);
+	if (! rx_busy)
+		return;
+	const auto start = std::chrono::steady_clock::now();
+	if (pMainWindow->cfg.GetData()->bTXPreemptsRX) {
+		// cut off what we're hearing, the playback stage throws away the rest
+		rx_preempt = true;
+		for (auto &lane : lanes)
+			lane->jitter.Stop();
 	}
+	// letting go of the PTT stops the wait too, see MicOff()
+	rx_cv.wait(lck, [this]{ return ! rx_busy || ! hot_mic; });
+	const std::chrono::duration<double, std::milli> waited(std::chrono::steady_clock::now() - start);
+	SendLog("Tailgating detected! Waited %d ms for received audio to finish.\n", int(waited.count()));
+}
+
+// the mic is turned off, and a capture job waiting in WaitRXDrained() is let go
+void CAudioManager::MicOff()
+{
+	hot_mic = false;
+	std::lock_guard<std::mutex> lck(rx_mtx);
+	rx_cv.notify_all();
+}
+
+// the high-pass filter, AGC and limiter, or just a copy if they're all off
+void CAudioManager::Condition(const short *in, short *out)
+{
+	if (conditioner.IsActive()) {
+		const auto start = CLatency::Now();
+		conditioner.Process(in, out);
+		CLatency::Since(ELatencyStage::txCondition, start);
+	} else
+		memcpy(out, in, 160 * sizeof(short));
 }
 
 void CAudioManager::audio2codec(const bool is_3200)
 {
 	CCodec2 c2(is_3200);
 	bool last;
-	calc_audio_stats();  // initialize volume statistics
+	txMeter.Reset();
+	auto data = pMainWindow->cfg.GetData();
+	SConditionerSettings settings;
+	settings.highpass = data->iTXHighPass;
+	settings.agc = data->bTXAGC;
+	settings.agc_target = data->iTXAGCTarget;
+	settings.limiter = data->bTXLimiter;
+	conditioner.Reset(settings);
 	bool is_odd = false; // true if we've processed an odd number of audio frames
 	do {
 		// we'll wait until there is something
 		CAudioFrame audioframe = audio_queue.WaitPop();
-		calc_audio_stats(audioframe.GetData());
+		CLatency::Since(ELatencyStage::txQueue, audioframe.GetStamp());
+		const auto origin = audioframe.GetOrigin();
 		last = audioframe.GetFlag();
 		if ( is_3200 ) {
 			is_odd = ! is_odd;
+			short audio[160];
+			Condition(audioframe.GetData(), audio);
+			txMeter.Update(audio);
 			unsigned char data[8];
-			c2.codec2_encode(data, audioframe.GetData());
+			auto start = CLatency::Now();
+			c2.codec2_encode(data, audio);
+			auto now = CLatency::Now();
+			CLatency::Record(ELatencyStage::txEncode, now - start);
 			CC2DataFrame dataframe(data);
 			dataframe.SetFlag(is_odd ? false : last);
+			dataframe.SetStamps(origin, now);
 			c2_queue.Push(dataframe);
 			if (is_odd && last) { // we need an even number of data frame for 3200
 				// add one more quite frame
@@ -119,33 +513,48 @@ void CAudioManager::audio2codec(const bool is_3200)
 				c2.codec2_encode(data, quiet);
 				CC2DataFrame frame2(data);
 				frame2.SetFlag(true);
+				frame2.SetStamps(origin, CLatency::Now());
 				c2_queue.Push(frame2);
 			}
 		} else { // 1600 - we need 40 ms of audio
 			short audio[320] = { 0 }; // initialize to 40 ms of silence
 			unsigned char data[8];
-			memcpy(audio, audioframe.GetData(), 160*sizeof(short)); // we'll put 20 ms of audio at the beginning
+			Condition(audioframe.GetData(), audio); // we'll put 20 ms of audio at the beginning
+			txMeter.Update(audio);
 			if (last) { // get another frame, if available
-				volStats.count += 160; // a quite frame will only contribute to the total count
+				txMeter.Skip(); // a quite frame will only contribute to the total count
 			} else {
 				//we'll wait until there is something
 				audioframe = audio_queue.WaitPop();
-				calc_audio_stats(audioframe.GetData());
-				memcpy(audio+160, audioframe.GetData(), 160*sizeof(short));	// now we have 40 ms total
+				CLatency::Since(ELatencyStage::txQueue, audioframe.GetStamp());
+				Condition(audioframe.GetData(), audio+160);	// now we have 40 ms total
+				txMeter.Update(audio+160);
 				last = audioframe.GetFlag();
 			}
+			const auto start = CLatency::Now();
 			c2.codec2_encode(data, audio);
+			const auto now = CLatency::Now();
+			CLatency::Record(ELatencyStage::txEncode, now - start);
 			CC2DataFrame dataframe(data);
 			dataframe.SetFlag(last);
+			dataframe.SetStamps(origin, now);
 			c2_queue.Push(dataframe);
 		}
 	} while (! last);
 }
 
-void CAudioManager::QuickKey(const std::string &d, const std::string &s)
+bool CAudioManager::QuickKey(const std::string &d, const std::string &s)
 {
-	hot_mic = true;
-	CPacket pack;
+	// hot_mic belongs to the PTT, so this never touches it
+	if (hot_mic || tx_started || tuning)
+		return true;
+	// the frames go out in real time, so don't hold up the GUI
+	return packetize.Run([this, d, s]{ QuickKeyFrames(d, s); });
+}
+
+void CAudioManager::QuickKeyFrames(const std::string &d, const std::string &s)
+{
+	CStreamFrame pack;
 	pack.Initialize(54u, true);
 	CCallsign dst(d), src(s);
 	pack.SetStreamId(random.NewStreamID());
@@ -155,22 +564,23 @@ void CAudioManager::QuickKey(const std::string &d, const std::string &s)
 	const uint8_t quiet[] = { 0x01u, 0x00u, 0x09u, 0x43u, 0x9cu, 0xe4u, 0x21u, 0x08u };
 	memcpy(pack.GetVoiceData(true),  quiet, 8);
 	memcpy(pack.GetVoiceData(false), quiet, 8);
+	CFrameClock clock(40u);
 	for (uint16_t i=0; i<5; i++) {
 		pack.SetFrameNumber((i < 4) ? i : i | 0x8000u);
 		pack.CalcCRC();
-		AM2M17.Write(pack.GetCData(), pack.GetSize());
+		clock.Wait();
+		AM2M17->Push(FRAME_LANE, pack);
 	}
-	hot_mic = false;
 }
 
-void CAudioManager::codec2gateway(const std::string &dst, const std::string &src, bool voiceonly)
+void CAudioManager::codec2gateway(const std::string &dst, const std::string &src, bool voiceonly, CFrameClock *clock)
 {
 	CCallsign destination(dst);
 	CCallsign source(src);
 
 	// make most of the M17 IP frame
 	// TODO: metadata and encryption and more TODOs mentioned later...
-	CPacket pack;
+	CStreamFrame pack;
 	pack.Initialize(54u, true);
 	pack.SetStreamId(random.NewStreamID());
 	pack.SetFrameType(voiceonly ? 0x5U : 0x7U);
@@ -184,6 +594,9 @@ void CAudioManager::codec2gateway(const std::string &dst, const std::string &src
 	do {
 		// we'll wait until there is something
 		CC2DataFrame cframe = c2_queue.WaitPop();
+		CLatency::Since(ELatencyStage::txC2Queue, cframe.GetStamp());
+		const auto origin = cframe.GetOrigin();
+		const auto start = CLatency::Now();
 		last = cframe.GetFlag();
 		memcpy(pack.GetVoiceData(), cframe.GetData(), 8);
 		if (voiceonly) {
@@ -195,6 +608,7 @@ void CAudioManager::codec2gateway(const std::string &dst, const std::string &src
 			} else {
 				// fill in the second part of the payload for C2 3200
 				cframe = c2_queue.WaitPop();
+				CLatency::Since(ELatencyStage::txC2Queue, cframe.GetStamp());
 				last = cframe.GetFlag();
 				memcpy(pack.GetVoiceData(false), cframe.GetData(), 8);
 			}
@@ -267,282 +681,611 @@ void CAudioManager::codec2gateway(const std::string &dst, const std::string &src
 
 		pack.CalcCRC();
 
-		AM2M17.Write(pack.GetCData(), pack.GetSize());
+		// a file is sent on the frame clock, the sound card paces the mic
+		if (clock) {
+			if (! clock->IsStarted())
+				clock->Start(40u);	// one frame of slack for the reader
+			clock->Wait();
+		}
+
+		// the gateway picks up the stamps using the frame number
+		CLatency::MarkTX(fn, origin, CLatency::Now());
+		// the recorder shares the gateway's copy
+		auto frame = AM2M17->NewFrame();
+		if (frame)
+			frame->CopyFrom(pack);
+		if (record_tx)
+			recorder.Put(frame, ERecordDir::tx);
+		AM2M17->Push(FRAME_LANE, std::move(frame));
+		CLatency::Since(ELatencyStage::txPacket, start);
 
 		count++;
 	} while (! last);
 }
 
-void CAudioManager::mic2audio()
+void CAudioManager::mic2audio(const std::string &device, const SAudioOptions &opts)
 {
-	auto data = pMainWindow->cfg.GetData();
-	// Open PCM device for recording (capture).
-	snd_pcm_t *handle;
-	int rc = snd_pcm_open(&handle, data->sAudioIn.c_str(), SND_PCM_STREAM_CAPTURE, 0);
-	if (rc < 0) {
-		std::cerr << "unable to open pcm device: " << snd_strerror(rc) << std::endl;
-		return;
-	}
-	// Allocate a hardware parameters object.
-	snd_pcm_hw_params_t *params;
-	snd_pcm_hw_params_alloca(&params);
-
-	// Fill it in with default values.
-	snd_pcm_hw_params_any(handle, params);
-
-	// Set the desired hardware parameters.
-
-	// Interleaved mode
-	snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_RW_INTERLEAVED);
-
-	// Signed 16-bit little-endian format
-	snd_pcm_hw_params_set_format(handle, params, SND_PCM_FORMAT_S16_LE);
-
-	// One channels (mono)
-	snd_pcm_hw_params_set_channels(handle, params, 1);
-
+	// Open the device for recording (capture).
 #ifdef USE44100
-	// 44100 samples/second
-	snd_pcm_hw_params_set_rate(handle, params, 44100, 0);
-	snd_pcm_uframes_t frames = shrink.input_frames;
+	const unsigned long frames = shrink.input_frames;
+	auto dev = CAudioDevice::Open(device, EAudioDirection::capture, 44100, frames, opts);
 #else
-	// 8000 samples/second
-	snd_pcm_hw_params_set_rate(handle, params, 8000, 0);
-	snd_pcm_uframes_t frames = 160;
+	const unsigned long frames = 160;
+	auto dev = CAudioDevice::Open(device, EAudioDirection::capture, 8000, frames, opts);
 #endif
-	snd_pcm_hw_params_set_period_size(handle, params, frames, 0);
-
-	// Write the parameters to the driver
-	rc = snd_pcm_hw_params(handle, params);
-	if (rc < 0) {
-		std::cerr << "unable to set hw parameters: " << snd_strerror(rc) << std::endl;
+	if (! dev)
 		return;
-	}
 
 	bool keep_running;
+	capture_period.Clear();
+	capture_ppm = 0.0;
+	auto prev = std::chrono::steady_clock::now();
+	// count the samples after the first second, once the device has settled, against our own clock
+	unsigned int periods = 0u;
+	unsigned long long counted = 0ull;
+	std::chrono::steady_clock::time_point counting;
+	unsigned int xruns = 0u;
 	do {
-		short int audio_buffer[frames];
+		// in mmap mode, this points right into the sound card's buffer
+		const short *audio_buffer = dev->Acquire(frames);
+		if (dev->GetXruns() != xruns) {
+			// samples were lost, so start counting the clock again
+			xruns = dev->GetXruns();
+			periods = 0u;
+			counted = 0ull;
+		}
 #ifdef USE44100
 		short int audio_frame[160];
 #endif
-		rc = snd_pcm_readi(handle, audio_buffer, frames);
-		if (rc == -EPIPE) {
-			// EPIPE means overrun
-			std::cerr << "overrun occurred" << std::endl;
-			snd_pcm_prepare(handle);
-		} else if (rc < 0) {
-			std::cerr << "error from readi: " << snd_strerror(rc) << std::endl;
-#ifdef USE44100
-		} else if (rc != int(shrink.input_frames)) {
-#else
-		} else if (rc != int(frames)) {
-#endif
-			std::cerr << "short readi, read " << rc << " frames" << std::endl;
+		// how far off the 20 ms period was this wake-up?
+		const auto now = std::chrono::steady_clock::now();
+		const std::chrono::duration<double, std::micro> period(now - prev);
+		prev = now;
+		capture_period.Add(std::fabs(period.count() - 20000.0));
+		if (++periods == 50u)
+			counting = now;
+		else if (periods > 50u) {
+			counted += frames;
+			const std::chrono::duration<double> elapsed(now - counting);
+			if (elapsed.count() > 1.0)
+				capture_ppm = (counted / (elapsed.count() * (frames * 50.0)) - 1.0) * 1.0e6;
 		}
+		if (dev->AtEnd())
+			hot_mic = false;	// the input file ran out
 		keep_running = hot_mic;
 #ifdef USE44100
-		RSShrink.Short2Float(audio_buffer, shrink.data_in, shrink.input_frames);
+		if (audio_buffer)
+			RSShrink.Short2Float(audio_buffer, shrink.data_in, shrink.input_frames);
+		else
+			memset(shrink.data_in, 0, shrink.input_frames * sizeof(float));
+		dev->Release();
 		if (RSShrink.Process(shrink))
 			keep_running = hot_mic = false;
 		RSShrink.Float2Short(shrink.data_out, audio_frame, shrink.output_frames);
 		CAudioFrame frame(audio_frame);
 #else
-		CAudioFrame frame(audio_buffer);
+		const short silence[160] = { 0 };	// if the device failed
+		CAudioFrame frame(audio_buffer ? audio_buffer : silence);
+		dev->Release();
 #endif
+		const auto stamp = CLatency::Now();
+		frame.SetStamps(stamp, stamp);
 		frame.SetFlag(! keep_running);
 		audio_queue.Push(frame);
 	} while (keep_running);
 #ifdef USE44100
 	RSShrink.Reset();
 #endif
-	snd_pcm_drop(handle);
-	snd_pcm_close(handle);
+	dev->Close(false);
+	ReportXruns(true, dev->GetXrunStats());
 }
 
-void CAudioManager::codec2audio(const bool is_3200)
+// keep the echo test for playback
+void CAudioManager::codec2echo(const bool is_3200)
 {
-	CCodec2 c2(is_3200);
+	echo.Start(is_3200);
 	bool last;
-	calc_audio_stats(); // init volume stats
 	do {
 		// we'll wait until there is something
 		CC2DataFrame dataframe = c2_queue.WaitPop();
 		last = dataframe.GetFlag();
+		echo.Add(dataframe.GetData());
+	} while (! last);
+	if (echo.Overwritten())
+		SendLog("The echo test was too long, only the last part will be played\n");
+}
+
+void CAudioManager::echo2audio()
+{
+	const int slot = mixer.Open();
+	if (slot < 0) {
+		std::cerr << "There's no free mixer slot for the echo!" << std::endl;
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lck(stream_mtx);
+		if (StartMixing()) {
+			mixer.Close(slot);
+			return;
+		}
+	}
+	const bool is_3200 = echo.Is3200();
+	CCodec2 c2(is_3200);
+	for (unsigned int i=0; i<echo.Size(); i++) {
 		if (is_3200) {
 			short audio[160];
-			c2.codec2_decode(audio, dataframe.GetData());
-			CAudioFrame audioframe(audio);
-			audioframe.SetFlag(last);
-			audio_queue.Push(audioframe);
-			calc_audio_stats(audio);
+			c2.codec2_decode(audio, echo.Get(i));
+			mixer.Push(slot, CAudioFrame(audio));
 		} else {
 			short audio[320];	// C2 1600 is 40 ms audio
-			c2.codec2_decode(audio, dataframe.GetData());
-			CAudioFrame audio1(audio), audio2(audio+160);
-			audio1.SetFlag(false);
-			audio2.SetFlag(last);
-			audio_queue.Push(audio1);
-			audio_queue.Push(audio2);
-			calc_audio_stats(audio);
-			calc_audio_stats(audio+160);
+			c2.codec2_decode(audio, echo.Get(i));
+			mixer.Push(slot, CAudioFrame(audio));
+			mixer.Push(slot, CAudioFrame(audio+160));
 		}
+	}
+	// it's been handed to the sound card once the mixer has taken all of it
+	mixer.WaitEmpty(slot);
+	mixer.Close(slot);
+}
+
+void CAudioManager::jitter2audio(SRXLane *lane, const bool is_3200)
+{
+	CCodec2 c2(is_3200);
+	bool last;
+	do {
+		// the jitter buffer hands us a frame every 40 ms
+		uint8_t payload[16];
+		int64_t origin;	// zero for concealed frames
+		const auto type = lane->jitter.Get(payload, &origin);
+		CLatency::Since(ELatencyStage::rxBuffer, origin);
+		if (EJitterFrame::stopped != type)
+			replay.Add(lane->number, payload);
+		last = (EJitterFrame::voice != type && EJitterFrame::concealed != type);
+		short audio[320];	// both C2 3200 and C2 1600 are 40 ms of audio per M17 frame
+		const auto start = CLatency::Now();
+		if (is_3200) {
+			c2.codec2_decode(audio, payload);
+			c2.codec2_decode(audio+160, payload+8);
+		} else {
+			c2.codec2_decode(audio, payload);
+		}
+		const auto now = CLatency::Now();
+		if (origin)
+			CLatency::Record(ELatencyStage::rxDecode, now - start);
+		CAudioFrame audio1(audio), audio2(audio+160);
+		audio1.SetStamps(origin, now);
+		audio2.SetStamps(origin, now);
+		mixer.Push(lane->slot, audio1);
+		mixer.Push(lane->slot, audio2);
 	} while (! last);
+
+	const auto stats = lane->jitter.GetStats();
+	const auto level = mixer.GetLevel(lane->slot);
+	SendLog("RX jitter=%.1fms delay=%.0fms late=%u lost=%u concealed=%u sender clock=%+.0fppm\n", stats.jitter, stats.delay, stats.late, stats.lost, stats.concealed, stats.drift);
+	SendLog("RX level peak=%.0fdBFS rms=%.0fdBFS\n", level.peak, level.rms);
+	const auto d = lane->decode.GetWakeupStats();
+	const auto p = playback.GetWakeupStats();
+	SendLog("RX wake-up us: start decode=%.0f playback=%.0f\n", d.max, p.max);
+	ReportLatency(false);
 }
 
-void CAudioManager::PlayEchoDataThread()
+void CAudioManager::replay2audio(bool all)
 {
-	auto data = pMainWindow->cfg.GetData();
-	hot_mic = false;
-	mic2audio_fut.get();
-	audio2codec_fut.get();
+	auto streams = replay.GetStreams();
+	if (streams.empty())
+		return;
+	if (! all)
+		streams.erase(streams.begin(), streams.end() - 1);
+	const int slot = mixer.Open();
+	if (slot < 0) {
+		std::cerr << "There's no free mixer slot for the replay!" << std::endl;
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lck(stream_mtx);
+		if (StartMixing()) {
+			mixer.Close(slot);
+			return;
+		}
+	}
+	// a decoder for each mode, shared by all the streams
+	std::unique_ptr<CCodec2> c2[2];
+	for (const auto &s : streams) {
+		if (replay_stop)
+			break;
+		struct tm tm;
+		localtime_r(&s.start, &tm);
+		char when[16];
+		strftime(when, sizeof(when), "%H:%M:%S", &tm);
+		SendLog("Replaying %s to %s from %s\n", s.src.c_str(), s.dst.c_str(), when);
+		auto &decoder = c2[s.is_3200 ? 1 : 0];
+		if (! decoder)
+			decoder.reset(new CCodec2(s.is_3200));
+		uint8_t payload[16];
+		for (uint64_t pos=0u; ! replay_stop && ! replay.Get(s, pos, payload); ) {
+			short audio[320];	// both C2 3200 and C2 1600 are 40 ms of audio per M17 frame
+			if (s.is_3200) {
+				decoder->codec2_decode(audio, payload);
+				decoder->codec2_decode(audio+160, payload+8);
+			} else {
+				decoder->codec2_decode(audio, payload);
+			}
+			mixer.Push(slot, CAudioFrame(audio));
+			mixer.Push(slot, CAudioFrame(audio+160));
+		}
+	}
+	if (replay_stop)
+		SendLog("The replay was stopped\n");
+	mixer.WaitEmpty(slot);
+	mixer.Close(slot);
+}
 
-	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+void CAudioManager::PlayReplay(bool all, std::function<void()> done)
+{
+	replay_stop = false;
+	if (tuning || decode.Run([this, all, done]{ replay2audio(all); done(); }))
+		done();
+}
 
-	codec2audio_fut = std::async(std::launch::async, &CAudioManager::codec2audio, this, data->bVoiceOnlyEnable);
-	play_audio_fut = std::async(std::launch::async, &CAudioManager::play_audio, this);
-	codec2audio_fut.get();
-	play_audio_fut.get();
+void CAudioManager::PlayEcho(bool replay, std::function<void()> done)
+{
+	if (! replay)
+		MicOff();
+	if (tuning) {
+		done();	// nothing was recorded, and the sound card is busy
+		return;
+	}
+	// the GUI doesn't wait for any of this
+	if (decode.Run([this, replay, done]{
+		if (! replay) {
+			capture.Wait();
+			encode.Wait();
+			packetize.Wait();
+			if (! tx_started) {
+				done();
+				return;	// nothing was recorded
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		}
+		echo2audio();
+		done();
+	}))
+		done();
 }
 
-void CAudioManager::M17_2AudioMgr(const CPacket &pack)
+// This is called on the main window's read thread, so it must never wait on the audio stages.
+void CAudioManager::M17_2AudioMgr(const CFrameRef &frame)
 {
-	static bool is_3200;
-	if (! play_file) {
-		if (0U==m17_sid_in && 0U==(pack.GetFrameNumber() & 0x8000u)) {	// don't start if it's the last audio frame
-			// here comes a new stream
-			m17_sid_in = pack.GetStreamId();
-			is_3200 = ((pack.GetFrameType() & 0x6u) == 0x4u);
-			pMainWindow->Receive(true);
-			// launch the audio processing threads
-			codec2audio_fut = std::async(std::launch::async, &CAudioManager::codec2audio, this, is_3200);
-			play_audio_fut = std::async(std::launch::async, &CAudioManager::play_audio, this);
+	// everything we hear is archived, even when it can't be played
+	if (record_rx)
+		recorder.Put(frame, ERecordDir::rx);
+	const auto &pack = *frame;
+	if (play_file)
+		return;
+	// the gateway stamped the frame when it came off the network
+	const auto now = CLatency::Now();
+	auto stamp = pack.GetRXTime();
+	if (stamp)
+		CLatency::Record(ELatencyStage::rxIPC, now - stamp);
+	else
+		stamp = now;
+
+	std::lock_guard<std::mutex> lck(stream_mtx);
+	// streams are told apart by the gateway's key, the stream id alone isn't enough
+	const auto key = pack.GetStreamKey();
+	if (0U == key)
+		return;
+	if (tuning) {
+		// the stream wins, it's held until the tuning stops and gives up the sound card
+		tune_stop = true;
+		if ((0U == pending_key || key == pending_key) && pending.size() < 64u) {
+			pending_key = key;
+			pending.emplace_back(frame, stamp);
 		}
-		if (pack.GetStreamId() != m17_sid_in)
+		return;
+	}
+	SRXLane *idle = nullptr;
+	for (auto &lane : lanes) {
+		if (key == lane->key) {
+			lane->jitter.Put(pack, stamp);
 			return;
-		CC2DataFrame dataframe(pack.GetCVoiceData());
-		auto last = (0x8000u == (pack.GetFrameNumber() & 0x8000u));
-		dataframe.SetFlag(is_3200 ? false : last);
-		c2_queue.Push(dataframe);
-		if (is_3200) {
-			CC2DataFrame frame2(pack.GetCVoiceData(false));
-			frame2.SetFlag(last);
-			c2_queue.Push(frame2);
 		}
-		if (last) {
-			codec2audio_fut.get();	// we're done, get the finished threads and reset the current stream id
-			play_audio_fut.get();
-			m17_sid_in = 0U;
-			pMainWindow->Receive(false);
+		if (0U == lane->key && nullptr == idle)
+			idle = lane.get();
+	}
+	if (nullptr == idle || key == pending_key) {
+		// every lane is busy, keep this one until a stream is done
+		if ((0U == pending_key || key == pending_key) && pending.size() < 64u) {
+			pending_key = key;
+			pending.emplace_back(frame, stamp);
 		}
+		return;
 	}
+	if (pack.GetFrameNumber() & 0x8000u)
+		return;	// don't start if it's the last audio frame
+	if (StartStream(idle, pack))
+		return;
+	idle->jitter.Put(pack, stamp);
 }
 
-void CAudioManager::play_audio()
+// stream_mtx must be locked, returns true if the stream couldn't be started
+bool CAudioManager::StartStream(SRXLane *lane, const CStreamFrame &pack)
 {
-	auto data = pMainWindow->cfg.GetData();
-	std::this_thread::sleep_for(std::chrono::milliseconds(300));
-	// Open PCM device for playback.
-	snd_pcm_t *handle;
-	int rc = snd_pcm_open(&handle, data->sAudioOut.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
-	if (rc < 0) {
-		std::cerr << "unable to open pcm device: " << snd_strerror(rc) << std::endl;
-		return;
+	const int slot = mixer.Open(lane->gain);
+	if (slot < 0) {
+		std::cerr << "There's no free mixer slot for stream " << std::hex << pack.GetStreamId() << std::dec << std::endl;
+		return true;
 	}
+	if (StartMixing()) {
+		mixer.Close(slot);
+		return true;
+	}
+	// here comes a new stream
+	lane->key = pack.GetStreamKey();
+	lane->slot = slot;
+	const bool is_3200 = ((pack.GetFrameType() & 0x6u) == 0x4u);
+	const auto sid = pack.GetStreamId();
+	lane->jitter.Start(sid, is_3200);
+	// the decoder may still be finishing the last stream, this one is queued behind it
+	const std::string src(CCallsign(pack.GetCSrcAddress()).GetCS()), dst(CCallsign(pack.GetCDstAddress()).GetCS());
+	if (lane->decode.Run([this, lane, is_3200, sid, src, dst]{
+		replay.Start(lane->number, sid, is_3200, src, dst);
+		jitter2audio(lane, is_3200);
+		replay.End(lane->number);
+		EndStream(lane);
+	})) {
+		// the playback stage will stop on its own when it finds the mixer empty
+		std::cerr << "The decoder for stream " << std::hex << sid << std::dec << " is still busy" << std::endl;
+		lane->jitter.Stop();
+		lane->key = 0U;
+		lane->slot = -1;
+		mixer.Close(slot);
+		return true;
+	}
+	pMainWindow->Receive(true);
+	heard = true;
+	return false;
+}
 
-	// Allocate a hardware parameters object.
-	snd_pcm_hw_params_t *params;
-	snd_pcm_hw_params_alloca(&params);
-
-	/* Fill it in with default values. */
-	snd_pcm_hw_params_any(handle, params);
+// Runs on the lane's decode thread after its stream has been decoded.
+void CAudioManager::EndStream(SRXLane *lane)
+{
+	std::lock_guard<std::mutex> lck(stream_mtx);
+	mixer.Close(lane->slot);
+	lane->key = 0U;
+	lane->slot = -1;
+	StartPending(lane);
+}
 
-	// Set the desired hardware parameters.
+// stream_mtx must be locked, a waiting transmission goes to the idle lane
+void CAudioManager::StartPending(SRXLane *lane)
+{
+	auto next = std::move(pending);
+	pending.clear();
+	pending_key = 0U;
+	for (const auto &p : next) {
+		if (hot_mic)
+			break;
+		if (0U == lane->key) {
+			if (p.first->GetFrameNumber() & 0x8000u)
+				break;
+			if (StartStream(lane, *p.first))
+				break;
+		}
+		lane->jitter.Put(*p.first, p.second);
+	}
+}
 
-	// Interleaved mode
-	snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+// stream_mtx must be locked, returns true if the playback stage couldn't be started
+bool CAudioManager::StartMixing()
+{
+	if (mixing)
+		return false;	// the playback stage will pick up the new slot
+	mixing = true;
+	StartRX();
+	if (playback.Run([this]{
+		do {
+			play_audio();
+		} while (KeepMixing());
+	})) {
+		SendLog("The playback thread is busy, nothing can be played\n");
+		mixing = false;
+		RXDrained();
+		return true;
+	}
+	return false;
+}
 
-	// Signed 16-bit little-endian format
-	snd_pcm_hw_params_set_format(handle, params, SND_PCM_FORMAT_S16_LE);
+bool CAudioManager::IsReceiving()
+{
+	std::lock_guard<std::mutex> lck(stream_mtx);
+	return heard;
+}
 
-	// One channels (mono)
-	snd_pcm_hw_params_set_channels(handle, params, 1);
+// Runs on the playback thread after the mixer ran out of sources.
+bool CAudioManager::KeepMixing()
+{
+	std::lock_guard<std::mutex> lck(stream_mtx);
+	if (! mixer.IsIdle())
+		return true;	// a stream started while the device was closing
+	mixing = false;
+	if (heard) {
+		heard = false;
+		pMainWindow->Receive(false);
+	}
+	// still under the stream lock, so a new stream can't slip in before TX hears about this
+	RXDrained();
+	return false;
+}
 
+void CAudioManager::play_audio()
+{
+	auto data = pMainWindow->cfg.GetData();
+	// Open the device for playback.
 #ifdef USE44100
-	// samples/second sampling rate
-	snd_pcm_hw_params_set_rate(handle, params, 44100, 0);
-	// Set period size to 160 frames.
-	snd_pcm_uframes_t frames = expand.input_frames;
+	const unsigned long frames = expand.input_frames;
+	auto dev = CAudioDevice::Open(audio_out.empty() ? data->sAudioOut : audio_out, EAudioDirection::playback, 44100, frames, DeviceOptions(EAudioDirection::playback));
 #else
-	// samples/second sampling rate
-	snd_pcm_hw_params_set_rate(handle, params, 8000, 0);
-	// Set period size to 160 frames.
-	snd_pcm_uframes_t frames = 160;
+	const unsigned long frames = 160;
+	auto dev = CAudioDevice::Open(audio_out.empty() ? data->sAudioOut : audio_out, EAudioDirection::playback, 8000, frames, DeviceOptions(EAudioDirection::playback));
 #endif
-	snd_pcm_hw_params_set_period_size(handle, params, frames, 0);
-	//snd_pcm_hw_params_set_period_size_near(handle, params, &frames, &dir);
-
-	// Write the parameters to the driver
-	rc = snd_pcm_hw_params(handle, params);
-	if (rc < 0) {
-		std::cerr << "unable to set hw parameters: " << snd_strerror(rc) << std::endl;
+	short mixed[160];
+	int64_t origin, stamp;
+	if (! dev) {
+		// nobody else will empty the mixer
+		while (! mixer.Mix(mixed, origin, stamp))
+			;
 		return;
 	}
 
-	// Use a buffer large enough to hold one period
-	snd_pcm_hw_params_get_period_size(params, &frames, 0);
+	// Start with 40 ms of silence. The jitter buffer releases 40 ms at a time,
+	// so this keeps the device from running dry between releases.
+#ifdef USE44100
+	const unsigned long devframes = expand.output_frames;
+#else
+	const unsigned long devframes = frames;
+#endif
+	WriteSilence(dev.get(), devframes, 2);
+	unsigned int xruns = 0u;
 
-	bool last;
-	do {
+	// the sound card's clock won't match the sender's, so resample by a few ppm to keep the fill level steady
+	const bool compensate = data->bDriftCompensation;
+	CDriftResampler drift;
+	CDriftControl control;
 #ifdef USE44100
-		short short_out[882];
+	const double rate = 44100.0;
+#else
+	const double rate = 8000.0;
 #endif
-		CAudioFrame frame(audio_queue.WaitPop());	// wait for a packet
-		last = frame.GetFlag();
+
+	rxMeter.Reset();
+	mixer.GetClipped();
+	bool last = false;
+	// every source is summed on the sound card's 20 ms clock
+	while (! mixer.Mix(mixed, origin, stamp)) {
+		// echo and concealed frames have no origin, so they aren't timed
+		if (origin)
+			CLatency::Since(ELatencyStage::rxQueue, stamp);
+		const auto start = CLatency::Now();
+		if (rx_preempt || last)
+			continue;	// TX has taken over, just empty the mixer
+		rxMeter.Update(mixed);
 #ifdef USE44100
-		RSExpand.Short2Float(frame.GetData(), expand.data_in, expand.input_frames);
+		RSExpand.Short2Float(mixed, expand.data_in, expand.input_frames);
 		if (RSExpand.Process(expand))
 			last = true;
-		RSExpand.Float2Short(expand.data_out, short_out, expand.output_frames);
-		rc = snd_pcm_writei(handle, short_out, expand.output_frames);
+		// in mmap mode, the resamplers write right into the sound card's buffer
+		const unsigned long count = compensate ? drift.OutputCount(expand.output_frames) : expand.output_frames;
+		auto out = dev->Acquire(count);
+		if (out) {
+			if (compensate)
+				drift.Process(expand.data_out, expand.output_frames, out);
+			else
+				RSExpand.Float2Short(expand.data_out, out, expand.output_frames);
+		}
 #else
-		rc = snd_pcm_writei(handle, frame.GetData(), frames);
+		const unsigned long count = compensate ? drift.OutputCount(frames) : frames;
+		auto out = dev->Acquire(count);
+		if (out) {
+			if (compensate) {
+				float in[160];
+				for (unsigned i=0; i<160; i++)
+					in[i] = mixed[i];
+				drift.Process(in, frames, out);
+			} else
+				memcpy(out, mixed, frames * sizeof(short));
+		}
 #endif
-		if (rc == -EPIPE) {
-			// EPIPE means underrun
-			// std::cerr << "underrun occurred" << std::endl;
-			snd_pcm_prepare(handle);
-		} else if (rc < 0) {
-			std::cerr <<  "error from writei: " << snd_strerror(rc) << std::endl;
+		if (out)
+			dev->Release();
+		if (dev->GetXruns() != xruns) {
+			// it ran dry, so put back the lead we started with and let the drift control settle again
+			xruns = dev->GetXruns();
+			WriteSilence(dev.get(), devframes, 2);
+			control.Reset();
+			drift.Reset();
+		}
+		if (compensate)
+			drift.SetRatio(control.Update(1000.0 * dev->Delay() / rate, 0.02));
+		if (origin) {
+			const auto now = CLatency::Now();
+			CLatency::Record(ELatencyStage::rxWrite, now - start);
+			// how long before what we just wrote will actually be heard
 #ifdef USE44100
-		}  else if (rc != int(expand.output_frames)) {
+			const int64_t device = int64_t(dev->Delay()) * 1000000000 / 44100;
 #else
-		}  else if (rc != int(frames)) {
+			const int64_t device = int64_t(dev->Delay()) * 1000000000 / 8000;
 #endif
-			std::cerr << "short write, wrote " << rc << " frames" << std::endl;
+			CLatency::Record(ELatencyStage::rxDevice, device);
+			CLatency::Record(ELatencyStage::rxTotal, now - origin + device);
 		}
-	} while (! last);
+	}
 
-	snd_pcm_drain(handle);
-	snd_pcm_close(handle);
+	dev->Close(! rx_preempt);
 #ifdef USE44100
 	RSExpand.Reset();
 #endif
+	ReportXruns(false, dev->GetXrunStats());
+	const auto clipped = mixer.GetClipped();
+	if (clipped)
+		SendLog("RX mixer saturated %u samples\n", clipped);
+	if (compensate)
+		SendLog("RX sound card correction=%+.0fppm fill=%.1fms (started at %.1fms)\n", control.GetPPM(), control.GetFill(), control.GetSetpoint());
 }
 
 void CAudioManager::KeyOff()
 {
 	if (hot_mic) {
-		hot_mic = false;
-		mic2audio_fut.get();
-		audio2codec_fut.get();
-		codec2gateway_fut.get();
+		MicOff();
+		capture.Wait();
+		encode.Wait();
+		packetize.Wait();
+		const auto c = capture.GetWakeupStats();
+		const auto e = encode.GetWakeupStats();
+		const auto p = packetize.GetWakeupStats();
+		SendLog("TX wake-up us: capture period avg=%.0f max=%.0f, start capture=%.0f encode=%.0f packetize=%.0f\n", capture_period.Average(), capture_period.max, c.max, e.max, p.max);
+		// it takes a couple of seconds for the estimate to mean anything
+		if (capture_ppm != 0.0)
+			SendLog("TX capture clock=%+.0fppm\n", capture_ppm);
+		ReportLatency(true);
+	}
+}
+
+// fill the sound card with this many periods of silence
+void CAudioManager::WriteSilence(CAudioDevice *dev, unsigned long frames, int periods)
+{
+	for (int i=0; i<periods; i++) {
+		auto out = dev->Acquire(frames);
+		if (nullptr == out)
+			return;
+		memset(out, 0, frames * sizeof(short));
+		dev->Release();
 	}
 }
 
+void CAudioManager::ReportXruns(bool capture, const SXrunStats &stats)
+{
+	CLatency::AddXruns(capture, stats);
+	if (stats.Any())
+		SendLog("%s sound card xruns=%u short=%u errors=%u dropped=%lu frames recovery us avg/max=%.0f/%.0f\n", capture ? "TX" : "RX", stats.xruns, stats.shorts, stats.errors, stats.dropped, stats.recoveries ? stats.recovery_sum / stats.recoveries : 0.0, stats.recovery_max);
+	if (stats.lasterror)
+		SendLog("%s sound card's last error: %s\n", capture ? "TX" : "RX", stats.lasterror);
+}
+
+void CAudioManager::ReportLatency(bool tx)
+{
+	char line[256];
+	CLatency::Summary(tx, line, sizeof(line));
+	SendLog("%s", line);
+	const std::string path(std::string(CFGDIR) + "/latency.json");
+	if (CLatency::Export(path))
+		std::cerr << "Could not write " << path << std::endl;
+}
+
 void CAudioManager::Link(const std::string &linkcmd)
 {
 	if (0 == linkcmd.compare(0, 3, "M17")) { //it's an M17 link/unlink command
-		CPacket pack;
+		CStreamFrame pack;
 		pack.Initialize(54, true);
 		if ('L' == linkcmd.at(3)) {
 			if (13 == linkcmd.size()) {
@@ -551,29 +1294,12 @@ void CAudioManager::Link(const std::string &linkcmd)
 				CCallsign dest(sDest);
 				dest.CodeOut(pack.GetDstAddress());
 				//printf("Link Packet: dest=%s=0x%02x%02x%02x%02x%02x%02x\n", dest.GetCS().c_str(), pack.GetCDstAddress()[0], pack.GetCDstAddress()[1], pack.GetCDstAddress()[2], pack.GetCDstAddress()[3], pack.GetCDstAddress()[4], pack.GetCDstAddress()[5]);
-				AM2M17.Write(pack.GetCData(), pack.GetSize());
+				AM2M17->Push(LINK_LANE, pack);
 			}
 		} else if ('U' == linkcmd.at(3)) {
 			CCallsign dest("U");
 			dest.CodeOut(pack.GetDstAddress());
-			AM2M17.Write(pack.GetCData(), pack.GetSize());
-		}
-	}
-}
-
-void CAudioManager::calc_audio_stats(const short int *wave)
-{
-	if (wave) {
-		double ss = 0.0;
-		for (unsigned int i=0; i<160; i++) {
-			auto a = (unsigned int)abs(wave[i]);
-			if (a > 16383) volStats.clip++;
-			if (i % 2) ss += double(a) * double(a); // every other point will do
+			AM2M17->Push(LINK_LANE, pack);
 		}
-		volStats.count += 160;
-		volStats.ss += ss;
-	} else {
-		volStats.count = volStats.clip = 0;
-		volStats.ss = 0.0;
 	}
 }
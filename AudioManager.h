@@ -19,12 +19,16 @@
 #pragma once
 
 #include <string>
-#include <future>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <vector>
+#include <memory>
+#include <functional>
 
 #include "TemplateClasses.h"
+#include "JitterBuffer.h"
+#include "Worker.h"
 #include "UnixDgramSocket.h"
 #include "Message.h"
 #include "Packet.h"
@@ -32,17 +36,24 @@
 #include "GNSS.h"
 #include "Base.h"
 #include "CRC.h"
+#include "AudioDevice.h"
+#include "FrameClock.h"
+#include "Mixer.h"
+#include "EchoBuffer.h"
+#include "LevelMeter.h"
+#include "Conditioner.h"
+#include "Recorder.h"
+#include "ReplayBuffer.h"
+#include "FrameChannel.h"
 
 #ifdef USE44100
 #include "Resampler.h"
 #endif
 
-using M17PacketQueue = CTQueue<CPacket>;
-using SVolStats = struct volstats_tag
-{
-	int count, clip;
-	double ss;
-};
+// the most received streams that can be heard at the same time
+#define MAX_RX_STREAMS 4
+// how long each buffer size is tried for when tuning, three seconds
+#define TUNE_PERIODS 150u
 
 enum class E_PTT_Type { echo, m17 };
 
@@ -53,27 +64,84 @@ class CAudioManager : public CBase
 public:
 	CAudioManager();
 	bool Init(CMainWindow *);
+	// the AM2M17 channel has a lane for the packetize thread and one for the GUI's link commands
+	static constexpr unsigned FRAME_LANE = 0u, LINK_LANE = 1u, GATEWAY_LANES = 2u;
 	void BuildMetaBlocks();
-	void RecordMicThread(E_PTT_Type for_who, const std::string &urcall);
-	void PlayEchoDataThread();	// for Echo
-	void M17_2AudioMgr(const CPacket &m17);
+	// returns true if it couldn't be started
+	bool RecordMicThread(E_PTT_Type for_who, const std::string &urcall);
+	// Plays the echo test in the background, after the recording is finished, or again if replay is true.
+	// done is called on the decode thread when it's been played.
+	void PlayEcho(bool replay, std::function<void()> done);
+	bool HasEcho() const { return echo.Size() > 0u; }
+	// a received stream is being played
+	bool IsReceiving();
+	// Plays the last received stream, or every one that's still kept, without
+	// disturbing anything being received. done is called on the decode thread.
+	void PlayReplay(bool all, std::function<void()> done);
+	// from any thread, a replay that's playing stops at the next frame
+	void StopReplay() { replay_stop = true; }
+	bool HasReplay() { return replay.IsEnabled() && ! replay.GetStreams().empty(); }
+	void M17_2AudioMgr(const CFrameRef &frame);
 	void KeyOff();
-	void QuickKey(const std::string &dest, const std::string &sour);
+	// returns true if it was refused because we're already transmitting
+	bool QuickKey(const std::string &dest, const std::string &sour);
+	// transmit a WAV, raw or .c2 file in real time, done is called on the capture thread when it's finished,
+	// returns true if it couldn't be started
+	bool TransmitFile(const std::string &path, const std::string &urcall, std::function<void()> done);
 	void Link(const std::string &linkcmd);
+	// command line overrides of the configured audio devices, empty means use the configuration
+	void SetAudioDevices(const std::string &in, const std::string &out, bool nopace, bool loop);
+	// Finds the smallest buffer, in periods, that each device can run without xruns.
+	// done is called on the playback thread with the results, zero if a device couldn't be tuned.
+	// A received stream stops the tuning and is played when it's done.
+	// returns true if it couldn't be started because audio is being used
+	bool AutoTune(const std::string &in, const std::string &out, std::function<void(int, int)> done);
 
-	// for volume stats
-	SVolStats volStats;
+	// the levels of what we send and what we hear, for the GUI
+	CLevelMeter txMeter, rxMeter;
 
 private:
 	// data
-	std::atomic<bool> hot_mic, play_file;
-	std::atomic<unsigned short> m17_sid_in;
+	std::atomic<bool> hot_mic, play_file, tuning, tune_stop, tx_started, rx_preempt, replay_stop;
+	// set while received or echo audio is being played, TX waits for it to clear
+	std::mutex rx_mtx;
+	std::condition_variable rx_cv;
+	bool rx_busy;
+	// Each stream being heard has its own jitter buffer and decoder, feeding a mixer slot.
+	// The key and slot are guarded by stream_mtx. The key is the gateway's stream key,
+	// not the stream id, two talkers can pick the same one.
+	using SRXLane = struct rxlane_tag
+	{
+		uint32_t key;	// zero when the lane is idle
+		int slot;
+		unsigned int number;	// for the replay buffer
+		float gain;				// what its mixer slot is opened with
+		CJitterBuffer jitter;
+		CWorker decode;
+	};
+	std::mutex stream_mtx;
+	std::vector<std::unique_ptr<SRXLane>> lanes;
+	CMixer mixer;
+	bool mixing, heard;	// the playback stage is running, and it has played a stream
+	// a stream that arrived while every lane was busy
+	std::vector<std::pair<CFrameRef, int64_t>> pending;
+	uint32_t pending_key;
 	CGNSS gnss;
 	std::vector<SMeta> msgblks;
 	CAudioQueue audio_queue;
 	CC2DataQueue c2_queue;
-	std::future<void> mic2audio_fut, audio2codec_fut, codec2gateway_fut, codec2audio_fut, play_audio_fut;
+	CEchoBuffer echo;
+	CReplayBuffer replay;
+	CConditioner conditioner;	// only for the encode stage
+	CRecorder recorder;
+	bool record_rx, record_tx;
+	// the pipeline stages, created once in Init(), decode is only for echo
+	CWorker capture, encode, packetize, decode, playback;
+	SWakeupStats capture_period;
+	double capture_ppm;	// how fast the capture clock ran on the last over, compared to ours
 	bool link_open;
+	std::string audio_in, audio_out;
+	bool no_pace, loop_file;
 #ifdef USE44100
 	SDATA expand, shrink;
 	float expand_in[160], expand_out[882];
@@ -81,7 +149,9 @@ private:
 #endif
 
 	// Unix sockets
-	CUnixDgramWriter AM2M17, LogInput;
+	CUnixDgramWriter LogInput;
+	// to the gateway
+	CFrameChannel *AM2M17;
 	// helpers
 	CMainWindow *pMainWindow;
 	CRandom random;
@@ -93,10 +163,31 @@ private:
 #endif
 
 	// methods
-	void mic2audio();
+	void mic2audio(const std::string &device, const SAudioOptions &opts);
+	void c2file2codec(FILE *fp, bool is_3200);
 	void audio2codec(const bool is_3200);
-	void codec2audio(const bool is_3200);
-	void codec2gateway(const std::string &dest, const std::string &sour, bool voiceonly);
+	void Condition(const short *in, short *out);
+	void codec2echo(const bool is_3200);
+	void echo2audio();
+	void replay2audio(bool all);
+	void jitter2audio(SRXLane *lane, const bool is_3200);
+	void QuickKeyFrames(const std::string &dest, const std::string &sour);
+	bool StartTXStages(bool use_encoder, bool is_3200, std::function<void()> packetizer);
+	void codec2gateway(const std::string &dest, const std::string &sour, bool voiceonly, CFrameClock *clock = nullptr);
 	void play_audio();
-	void calc_audio_stats(const short int *audio = nullptr);
+	void StartRX();
+	bool StartStream(SRXLane *lane, const CStreamFrame &pack);
+	void EndStream(SRXLane *lane);
+	void StartPending(SRXLane *lane);
+	void EndTuning();
+	bool StartMixing();
+	bool KeepMixing();
+	void RXDrained();
+	void WaitRXDrained();
+	void MicOff();
+	SAudioOptions DeviceOptions(EAudioDirection dir);
+	int TuneDevice(const std::string &device, EAudioDirection dir);
+	void ReportLatency(bool tx);
+	void ReportXruns(bool capture, const SXrunStats &stats);
+	void WriteSilence(CAudioDevice *dev, unsigned long frames, int periods);
 };
@@ -26,7 +26,9 @@
 
 CBase::CBase()
 {
-	LogInput.SetUp("log_input");
+	// the audio stages and the gateway log from real-time threads, so a line the GUI
+	// has no room for is dropped and counted, it never holds them up
+	LogInput.SetUp("log_input", EWritePolicy::drop);
 }
 
 void CBase::SendLog(const char *fmt, ...)
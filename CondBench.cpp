@@ -0,0 +1,127 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+// Measures what the mic conditioning chain costs. Each setting is run over
+// the same 8000 samples/sec audio, one 20 ms frame at a time just like the
+// encode stage does it, and the time per frame is printed. The audio is a
+// raw S16_LE or WAV file, or a made up mix of speech-like tones, hum and DC.
+//
+// usage: condbench [file [passes]]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "Conditioner.h"
+
+#define FRAME 160u
+
+// so the output can't be optimized away
+static volatile short sink;
+
+// returns true on failure
+static bool ReadAudio(const char *path, std::vector<short> &audio)
+{
+	FILE *fp = fopen(path, "rb");
+	if (nullptr == fp)
+	{
+		std::cerr << "Could not open " << path << ": " << strerror(errno) << std::endl;
+		return true;
+	}
+	// a WAV file is taken to have the usual 44 byte header
+	char riff[4];
+	if (4 != fread(riff, 1, 4, fp) || memcmp(riff, "RIFF", 4))
+		rewind(fp);
+	else
+		fseek(fp, 44, SEEK_SET);
+	short buf[FRAME];
+	size_t n;
+	while ((n = fread(buf, sizeof(short), FRAME, fp)) > 0)
+		audio.insert(audio.end(), buf, buf + n);
+	fclose(fp);
+	// only whole frames
+	audio.resize(audio.size() - audio.size() % FRAME);
+	if (audio.empty())
+	{
+		std::cerr << path << " doesn't have a whole frame of audio" << std::endl;
+		return true;
+	}
+	return false;
+}
+
+// ten seconds of a warbling voice-band tone that comes and goes, with 60 Hz hum and a DC offset
+static void MakeAudio(std::vector<short> &audio)
+{
+	audio.resize(80000u);
+	for (unsigned i=0; i<audio.size(); i++)
+	{
+		const double t = i / 8000.0;
+		const double voice = (0.5 + 0.5 * sin(2.0 * M_PI * 0.7 * t)) * sin(2.0 * M_PI * (300.0 + 200.0 * sin(2.0 * M_PI * 3.0 * t)) * t);
+		audio[i] = short(20000.0 * voice + 2000.0 * sin(2.0 * M_PI * 60.0 * t) + 1000.0);
+	}
+}
+
+static void Run(const char *name, const SConditionerSettings &settings, const std::vector<short> &audio, unsigned passes)
+{
+	CConditioner conditioner;
+	short out[FRAME];
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned p=0; p<passes; p++)
+	{
+		conditioner.Reset(settings);
+		for (size_t i=0; i<audio.size(); i+=FRAME)
+		{
+			conditioner.Process(audio.data() + i, out);
+			sink = out[FRAME-1u];
+		}
+	}
+	const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	const double frames = double(passes) * double(audio.size() / FRAME);
+	printf("%-10s %8.1f ns/frame, %.4f%% of real time\n", name, elapsed.count() / frames, 100.0 * elapsed.count() / (frames * 20.0e6));
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<short> audio;
+	if (argc > 1)
+	{
+		if (ReadAudio(argv[1], audio))
+			return 1;
+	}
+	else
+		MakeAudio(audio);
+	const unsigned passes = (argc > 2) ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 100u;
+	if (0u == passes)
+	{
+		std::cerr << "usage: " << argv[0] << " [file [passes]]" << std::endl;
+		return 1;
+	}
+	std::cout << audio.size() / FRAME << " frames, " << passes << " passes" << std::endl;
+
+	Run("off",       { 0,   false, -18, false }, audio, passes);
+	Run("high-pass", { 100, false, -18, false }, audio, passes);
+	Run("agc",       { 0,   true,  -18, false }, audio, passes);
+	Run("limiter",   { 0,   false, -18, true  }, audio, passes);
+	Run("all",       { 100, true,  -18, true  }, audio, passes);
+	return 0;
+}
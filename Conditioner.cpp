@@ -0,0 +1,207 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "Conditioner.h"
+
+#define SAMPLE_RATE 8000.0
+// the limiter keeps peaks 1 dB below full scale
+#define CEILING 29204.0f
+// the AGC leaves frames quieter than this alone, so it doesn't bring up the background noise
+#define AGC_GATE_DB -45.0
+#define AGC_MIN_DB -12.0
+#define AGC_MAX_DB 24.0
+// of the error each frame, it comes down faster than it goes up
+#define AGC_ATTACK 0.3
+#define AGC_RELEASE 0.03
+// about 25 dB per second
+#define LIMITER_RELEASE 1.06f
+// samples to ramp to a lower gain, 1 ms
+#define ATTACK_SAMPLES 8u
+
+// the largest magnitude and the mean square of a frame
+static void FrameLevel(const float *in, float &peak, float &ms)
+{
+#if defined(__SSE2__)
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	__m128 max = _mm_setzero_ps(), sum = _mm_setzero_ps();
+	for (unsigned int i=0; i<160; i+=4) {
+		const __m128 x = _mm_loadu_ps(in + i);
+		max = _mm_max_ps(max, _mm_andnot_ps(sign, x));
+		sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+	}
+	float m[4], s[4];
+	_mm_storeu_ps(m, max);
+	_mm_storeu_ps(s, sum);
+#elif defined(__ARM_NEON)
+	float32x4_t max = vdupq_n_f32(0.0f), sum = vdupq_n_f32(0.0f);
+	for (unsigned int i=0; i<160; i+=4) {
+		const float32x4_t x = vld1q_f32(in + i);
+		max = vmaxq_f32(max, vabsq_f32(x));
+		sum = vmlaq_f32(sum, x, x);
+	}
+	float m[4], s[4];
+	vst1q_f32(m, max);
+	vst1q_f32(s, sum);
+#else
+	float m[4] = { 0.0f }, s[4] = { 0.0f };
+	for (unsigned int i=0; i<160; i++) {
+		const float a = std::fabs(in[i]);
+		if (a > m[i%4])
+			m[i%4] = a;
+		s[i%4] += in[i] * in[i];
+	}
+#endif
+	peak = std::fmax(std::fmax(m[0], m[1]), std::fmax(m[2], m[3]));
+	ms = (s[0] + s[1] + s[2] + s[3]) / 160.0f;
+}
+
+// out = in * gain, where the gain starts at from + step and goes up by step for count samples,
+// then stays at the last value, rounded and saturated to 16 bits
+static void ApplyGain(const float *in, short *out, float from, float step, unsigned int count)
+{
+#if defined(__SSE2__)
+	__m128 g = _mm_add_ps(_mm_set1_ps(from), _mm_mul_ps(_mm_set_ps(4.0f, 3.0f, 2.0f, 1.0f), _mm_set1_ps(step)));
+	const __m128 g4 = _mm_set1_ps(4.0f * step);
+	const __m128 last = _mm_set1_ps(from + count * step);
+	for (unsigned int i=0; i<160; i+=8) {
+		const __m128 ga = (i < count) ? g : last;
+		const __m128 gb = (i + 4u < count) ? _mm_add_ps(g, g4) : last;
+		g = _mm_add_ps(g, _mm_add_ps(g4, g4));
+		const __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), ga));
+		const __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), gb));
+		// _mm_packs_epi32 does the saturation
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+	}
+#elif defined(__ARM_NEON)
+	const float steps[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+	float32x4_t g = vmlaq_n_f32(vdupq_n_f32(from), vld1q_f32(steps), step);
+	const float32x4_t g4 = vdupq_n_f32(4.0f * step);
+	const float32x4_t last = vdupq_n_f32(from + count * step);
+	const float32x4_t half = vdupq_n_f32(0.5f);
+	for (unsigned int i=0; i<160; i+=4) {
+		const float32x4_t x = vmulq_f32(vld1q_f32(in + i), (i < count) ? g : last);
+		g = vaddq_f32(g, g4);
+		// round half away from zero, then vqmovn_s32 does the saturation
+		const float32x4_t r = vaddq_f32(x, vbslq_f32(vcltq_f32(x, vdupq_n_f32(0.0f)), vnegq_f32(half), half));
+		vst1_s16(out + i, vqmovn_s32(vcvtq_s32_f32(r)));
+	}
+#else
+	for (unsigned int i=0; i<160; i++) {
+		float a = in[i] * ((i < count) ? from + (i + 1u) * step : from + count * step);
+		if (a > 32767.0f)
+			a = 32767.0f;
+		else if (a < -32768.0f)
+			a = -32768.0f;
+		out[i] = short(lrintf(a));
+	}
+#endif
+}
+
+CConditioner::CConditioner()
+{
+	SConditionerSettings off;
+	off.highpass = 0;
+	off.agc = off.limiter = false;
+	off.agc_target = -18;
+	Reset(off);
+}
+
+void CConditioner::Reset(const SConditionerSettings &settings)
+{
+	highpass = (settings.highpass > 0 && settings.highpass < SAMPLE_RATE / 2.0);
+	agc = settings.agc;
+	limiter = settings.limiter;
+	target_db = settings.agc_target;
+	if (highpass) {
+		// a second order Butterworth high-pass, from the Audio EQ Cookbook
+		const double w0 = 2.0 * M_PI * settings.highpass / SAMPLE_RATE;
+		const double alpha = std::sin(w0) / std::sqrt(2.0);
+		const double c = std::cos(w0);
+		const double a0 = 1.0 + alpha;
+		b0 = b2 = (1.0 + c) / 2.0 / a0;
+		b1 = -(1.0 + c) / a0;
+		a1 = -2.0 * c / a0;
+		a2 = (1.0 - alpha) / a0;
+	} else {
+		b0 = 1.0;
+		b1 = b2 = a1 = a2 = 0.0;
+	}
+	z1 = z2 = 0.0;
+	agc_db = 0.0;
+	lim_gain = gain = 1.0f;
+	limited = 0u;
+}
+
+void CConditioner::Process(const short *in, short *out)
+{
+	// the filter is recursive, so it's one sample at a time
+	if (highpass) {
+		for (unsigned int i=0; i<160; i++) {
+			const double x = in[i];
+			const double y = b0 * x + z1;
+			z1 = b1 * x - a1 * y + z2;
+			z2 = b2 * x - a2 * y;
+			buf[i] = float(y);
+		}
+	} else {
+		for (unsigned int i=0; i<160; i++)
+			buf[i] = in[i];
+	}
+
+	float peak, ms;
+	FrameLevel(buf, peak, ms);
+
+	if (agc && ms > 0.0f) {
+		const double level = 10.0 * std::log10(ms / (32768.0 * 32768.0));
+		if (level > AGC_GATE_DB) {
+			const double error = target_db - (level + agc_db);
+			agc_db += error * ((error < 0.0) ? AGC_ATTACK : AGC_RELEASE);
+			if (agc_db < AGC_MIN_DB)
+				agc_db = AGC_MIN_DB;
+			else if (agc_db > AGC_MAX_DB)
+				agc_db = AGC_MAX_DB;
+		}
+	}
+	const float agc_gain = float(std::pow(10.0, agc_db / 20.0));
+
+	if (limiter) {
+		// let it come back up slowly, but turn it down as far as this frame needs
+		float allowed = lim_gain * LIMITER_RELEASE;
+		if (allowed > 1.0f)
+			allowed = 1.0f;
+		if (peak * agc_gain * allowed > CEILING) {
+			allowed = CEILING / (peak * agc_gain);
+			limited++;
+		}
+		lim_gain = allowed;
+	}
+
+	// ramp quickly down to a lower gain and slowly up to a higher one, so it never clicks
+	const float next = agc_gain * lim_gain;
+	const unsigned int count = (next < gain) ? ATTACK_SAMPLES : 160u;
+	ApplyGain(buf, out, gain, (next - gain) / count, count);
+	gain = next;
+}
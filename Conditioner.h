@@ -0,0 +1,56 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+using SConditionerSettings = struct conditionersettings_tag
+{
+	int highpass;	// corner frequency in Hz, 0 is off
+	bool agc;
+	int agc_target;	// dBFS
+	bool limiter;
+};
+
+// Cleans up the mic audio before it's encoded, one 20 ms frame of 8000
+// samples/sec at a time: a high-pass filter for DC and rumble, an automatic
+// gain control and a limiter. The gain for a whole frame is worked out before
+// any of it is used, so the limiter doesn't need a look-ahead buffer and the
+// chain adds no latency. Nothing is allocated after construction.
+class CConditioner
+{
+public:
+	CConditioner();
+	// at the start of an over
+	void Reset(const SConditionerSettings &settings);
+	bool IsActive() const { return highpass || agc || limiter; }
+	void Process(const short *in, short *out);
+	// what the AGC was doing at the end of the over
+	double GetGain() const { return agc_db; }
+	unsigned int GetLimited() const { return limited; }
+
+private:
+	bool highpass, agc, limiter;
+	double target_db;
+	double b0, b1, b2, a1, a2;	// the biquad
+	double z1, z2;
+	double agc_db;		// the gain the AGC wants
+	float lim_gain;		// what the limiter allows
+	float gain;			// what was used at the end of the last frame
+	unsigned int limited;	// frames the limiter turned down
+	float buf[160];
+};
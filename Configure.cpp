@@ -37,6 +37,32 @@ void CConfigure::SetDefaultValues()
 	data.sAudioOut.assign("default");
 	data.dLatitude = data.dLongitude = 0.0;
 	data.sMessage.clear();
+	// real-time
+	data.eRTPolicy = ERTPolicy::none;
+	data.iAudioPriority = 70;
+	data.iGatewayPriority = 60;
+	data.iAudioCPU = data.iGatewayCPU = -1;	// any cpu
+	data.bLockMemory = false;
+	data.bGatewayIOUring = false;
+	// file audio
+	data.bAudioFilePaced = true;
+	data.bAudioFileLoop = false;
+	data.bTXPreemptsRX = false;
+	data.iAudioInPeriods = data.iAudioOutPeriods = data.iAudioStartPeriods = 0;
+	data.bAudioMMap = false;
+	data.bDriftCompensation = true;
+	data.iRXStreams = 1;
+	data.sRXGains.clear();
+	data.iEchoSeconds = 60;
+	data.iReplayMinutes = 5;
+	data.iTXHighPass = 100;
+	data.bTXAGC = false;
+	data.iTXAGCTarget = -18;
+	data.bTXLimiter = true;
+	data.bRecordRX = false;
+	data.bRecordTX = false;
+	data.bRecordWAV = false;
+	data.sRecordPath.assign(std::string(CFGDIR) + "/archive");
 #ifndef NO_DHT
 	data.sBootstrap.assign("xrf757.openquad.net");
 #endif
@@ -94,6 +120,65 @@ void CConfigure::ReadData()
 			data.sMessage.assign(val);
 			if (data.sMessage.size() > 52)
 				data.sMessage.resize(52);
+		} else if (0 == strcmp(key, "RTPolicy")) {
+			if (0 == strcmp(val, "FIFO"))
+				data.eRTPolicy = ERTPolicy::fifo;
+			else if (0 == strcmp(val, "RR"))
+				data.eRTPolicy = ERTPolicy::rr;
+			else
+				data.eRTPolicy = ERTPolicy::none;
+		} else if (0 == strcmp(key, "RTAudioPriority")) {
+			data.iAudioPriority = std::atoi(val);
+		} else if (0 == strcmp(key, "RTGatewayPriority")) {
+			data.iGatewayPriority = std::atoi(val);
+		} else if (0 == strcmp(key, "AudioCPU")) {
+			data.iAudioCPU = std::atoi(val);
+		} else if (0 == strcmp(key, "GatewayCPU")) {
+			data.iGatewayCPU = std::atoi(val);
+		} else if (0 == strcmp(key, "LockMemory")) {
+			data.bLockMemory = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "GatewayIOUring")) {
+			data.bGatewayIOUring = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "AudioFilePaced")) {
+			data.bAudioFilePaced = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "AudioFileLoop")) {
+			data.bAudioFileLoop = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "TXPreemptsRX")) {
+			data.bTXPreemptsRX = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "AudioMMap")) {
+			data.bAudioMMap = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "DriftCompensation")) {
+			data.bDriftCompensation = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "AudioInPeriods")) {
+			data.iAudioInPeriods = std::atoi(val);
+		} else if (0 == strcmp(key, "AudioOutPeriods")) {
+			data.iAudioOutPeriods = std::atoi(val);
+		} else if (0 == strcmp(key, "AudioStartPeriods")) {
+			data.iAudioStartPeriods = std::atoi(val);
+		} else if (0 == strcmp(key, "RXStreams")) {
+			data.iRXStreams = std::atoi(val);
+		} else if (0 == strcmp(key, "RXGains")) {
+			data.sRXGains.assign(val);
+		} else if (0 == strcmp(key, "EchoSeconds")) {
+			data.iEchoSeconds = std::atoi(val);
+		} else if (0 == strcmp(key, "ReplayMinutes")) {
+			data.iReplayMinutes = std::atoi(val);
+		} else if (0 == strcmp(key, "TXHighPass")) {
+			data.iTXHighPass = std::atoi(val);
+		} else if (0 == strcmp(key, "TXAGC")) {
+			data.bTXAGC = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "TXAGCTarget")) {
+			data.iTXAGCTarget = std::atoi(val);
+		} else if (0 == strcmp(key, "TXLimiter")) {
+			data.bTXLimiter = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "RecordRX")) {
+			data.bRecordRX = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "RecordTX")) {
+			data.bRecordTX = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "RecordWAV")) {
+			data.bRecordWAV = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "RecordPath")) {
+			data.sRecordPath.assign(val);
 #ifndef NO_DHT
 		} else if (0 == strcmp(key, "DHTBootstrap")) {
 			data.sBootstrap.assign(val);
@@ -134,6 +219,42 @@ void CConfigure::WriteData()
 	file << "Latitude=" << std::fixed << std::setprecision(5) << data.dLatitude << std::endl;
 	file << "Longitude=" << std::fixed << std::setprecision(5) << data.dLongitude << std::endl;
 	file << "Message='" << data.sMessage << "'" << std::endl;
+	// real-time
+	file << "RTPolicy=";
+	if (data.eRTPolicy == ERTPolicy::fifo)
+		file << "FIFO";
+	else if (data.eRTPolicy == ERTPolicy::rr)
+		file << "RR";
+	else
+		file << "None";
+	file << std::endl;
+	file << "RTAudioPriority=" << data.iAudioPriority << std::endl;
+	file << "RTGatewayPriority=" << data.iGatewayPriority << std::endl;
+	file << "AudioCPU=" << data.iAudioCPU << std::endl;
+	file << "GatewayCPU=" << data.iGatewayCPU << std::endl;
+	file << "LockMemory=" << (data.bLockMemory ? "true" : "false") << std::endl;
+	file << "GatewayIOUring=" << (data.bGatewayIOUring ? "true" : "false") << std::endl;
+	// file audio
+	file << "AudioFilePaced=" << (data.bAudioFilePaced ? "true" : "false") << std::endl;
+	file << "AudioFileLoop=" << (data.bAudioFileLoop ? "true" : "false") << std::endl;
+	file << "TXPreemptsRX=" << (data.bTXPreemptsRX ? "true" : "false") << std::endl;
+	file << "AudioMMap=" << (data.bAudioMMap ? "true" : "false") << std::endl;
+	file << "DriftCompensation=" << (data.bDriftCompensation ? "true" : "false") << std::endl;
+	file << "AudioInPeriods=" << data.iAudioInPeriods << std::endl;
+	file << "AudioOutPeriods=" << data.iAudioOutPeriods << std::endl;
+	file << "AudioStartPeriods=" << data.iAudioStartPeriods << std::endl;
+	file << "RXStreams=" << data.iRXStreams << std::endl;
+	file << "RXGains='" << data.sRXGains << "'" << std::endl;
+	file << "EchoSeconds=" << data.iEchoSeconds << std::endl;
+	file << "ReplayMinutes=" << data.iReplayMinutes << std::endl;
+	file << "TXHighPass=" << data.iTXHighPass << std::endl;
+	file << "TXAGC=" << (data.bTXAGC ? "true" : "false") << std::endl;
+	file << "TXAGCTarget=" << data.iTXAGCTarget << std::endl;
+	file << "TXLimiter=" << (data.bTXLimiter ? "true" : "false") << std::endl;
+	file << "RecordRX=" << (data.bRecordRX ? "true" : "false") << std::endl;
+	file << "RecordTX=" << (data.bRecordTX ? "true" : "false") << std::endl;
+	file << "RecordWAV=" << (data.bRecordWAV ? "true" : "false") << std::endl;
+	file << "RecordPath='" << data.sRecordPath << "'" << std::endl;
 #ifndef NO_DHT
 	// DHT
 	file << "DHTBootstrap='" << data.sBootstrap << "'" << std::endl;
@@ -157,6 +278,35 @@ void CConfigure::CopyFrom(const CFGDATA &from)
 	data.dLongitude = from.dLongitude;
 	// message
 	data.sMessage.assign(from.sMessage);
+	// real-time
+	data.eRTPolicy = from.eRTPolicy;
+	data.iAudioPriority = from.iAudioPriority;
+	data.iGatewayPriority = from.iGatewayPriority;
+	data.iAudioCPU = from.iAudioCPU;
+	data.iGatewayCPU = from.iGatewayCPU;
+	data.bLockMemory = from.bLockMemory;
+	data.bGatewayIOUring = from.bGatewayIOUring;
+	// file audio
+	data.bAudioFilePaced = from.bAudioFilePaced;
+	data.bAudioFileLoop = from.bAudioFileLoop;
+	data.bTXPreemptsRX = from.bTXPreemptsRX;
+	data.bAudioMMap = from.bAudioMMap;
+	data.bDriftCompensation = from.bDriftCompensation;
+	data.iAudioInPeriods = from.iAudioInPeriods;
+	data.iAudioOutPeriods = from.iAudioOutPeriods;
+	data.iAudioStartPeriods = from.iAudioStartPeriods;
+	data.iRXStreams = from.iRXStreams;
+	data.sRXGains.assign(from.sRXGains);
+	data.iEchoSeconds = from.iEchoSeconds;
+	data.iReplayMinutes = from.iReplayMinutes;
+	data.iTXHighPass = from.iTXHighPass;
+	data.bTXAGC = from.bTXAGC;
+	data.iTXAGCTarget = from.iTXAGCTarget;
+	data.bTXLimiter = from.bTXLimiter;
+	data.bRecordRX = from.bRecordRX;
+	data.bRecordTX = from.bRecordTX;
+	data.bRecordWAV = from.bRecordWAV;
+	data.sRecordPath.assign(from.sRecordPath);
 #ifndef NO_DHT
 	// DHT
 	data.sBootstrap.assign(from.sBootstrap);
@@ -179,6 +329,35 @@ void CConfigure::CopyTo(CFGDATA &to)
 	to.dLongitude = data.dLongitude;
 	// messge
 	to.sMessage.assign(data.sMessage);
+	// real-time
+	to.eRTPolicy = data.eRTPolicy;
+	to.iAudioPriority = data.iAudioPriority;
+	to.iGatewayPriority = data.iGatewayPriority;
+	to.iAudioCPU = data.iAudioCPU;
+	to.iGatewayCPU = data.iGatewayCPU;
+	to.bLockMemory = data.bLockMemory;
+	to.bGatewayIOUring = data.bGatewayIOUring;
+	// file audio
+	to.bAudioFilePaced = data.bAudioFilePaced;
+	to.bAudioFileLoop = data.bAudioFileLoop;
+	to.bTXPreemptsRX = data.bTXPreemptsRX;
+	to.bAudioMMap = data.bAudioMMap;
+	to.bDriftCompensation = data.bDriftCompensation;
+	to.iAudioInPeriods = data.iAudioInPeriods;
+	to.iAudioOutPeriods = data.iAudioOutPeriods;
+	to.iAudioStartPeriods = data.iAudioStartPeriods;
+	to.iRXStreams = data.iRXStreams;
+	to.sRXGains.assign(data.sRXGains);
+	to.iEchoSeconds = data.iEchoSeconds;
+	to.iReplayMinutes = data.iReplayMinutes;
+	to.iTXHighPass = data.iTXHighPass;
+	to.bTXAGC = data.bTXAGC;
+	to.iTXAGCTarget = data.iTXAGCTarget;
+	to.bTXLimiter = data.bTXLimiter;
+	to.bRecordRX = data.bRecordRX;
+	to.bRecordTX = data.bRecordTX;
+	to.bRecordWAV = data.bRecordWAV;
+	to.sRecordPath.assign(data.sRecordPath);
 #ifndef NO_DHT
 	// DHT
 	to.sBootstrap.assign(data.sBootstrap);
@@ -23,6 +23,7 @@
 #define IS_TRUE(a) ((a)=='t' || (a)=='T' || (a)=='1')
 
 enum class EInternetType { ipv4only, ipv6only, dualstack };
+enum class ERTPolicy { none, fifo, rr };
 
 using CFGDATA = struct CFGData_struct {
 	std::string sAudioIn, sAudioOut, sM17SourceCallsign, sMessage;
@@ -33,6 +34,34 @@ using CFGDATA = struct CFGData_struct {
 	EInternetType eNetType;
 	char cModule;
 	double dLatitude, dLongitude;
+	// real-time scheduling of the audio and gateway threads
+	ERTPolicy eRTPolicy;
+	int iAudioPriority, iGatewayPriority, iAudioCPU, iGatewayCPU;
+	bool bLockMemory;
+	bool bGatewayIOUring;
+	// "file:" audio devices
+	bool bAudioFilePaced, bAudioFileLoop;
+	// ALSA memory mapped access
+	bool bAudioMMap;
+	// ALSA buffer sizes in periods, and how many periods are queued before playback starts, zero is the driver's choice
+	int iAudioInPeriods, iAudioOutPeriods, iAudioStartPeriods;
+	// keying up cuts off received audio instead of waiting for it to finish
+	bool bTXPreemptsRX;
+	// resample playback by a few ppm to follow the sender's clock
+	bool bDriftCompensation;
+	// how many received streams can be heard at once, and the gain of each lane in dB, like "0,-6"
+	int iRXStreams;
+	std::string sRXGains;
+	// the longest echo test that is kept, in seconds
+	int iEchoSeconds;
+	// how many minutes of received streams are kept for a replay, zero is none
+	int iReplayMinutes;
+	// mic audio conditioning: high-pass corner in Hz (0 is off), AGC and its target in dBFS, limiter
+	int iTXHighPass, iTXAGCTarget;
+	bool bTXAGC, bTXLimiter;
+	// the stream archive: what to record, decoded to WAV or raw, and where
+	bool bRecordRX, bRecordTX, bRecordWAV;
+	std::string sRecordPath;
 };
 
 class CConfigure
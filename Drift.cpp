@@ -0,0 +1,118 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <cmath>
+
+#include "Drift.h"
+
+// the fill level is smoothed over about two seconds, to ride over the 40 ms bursts from the jitter buffer
+#define FILL_ALPHA 0.01
+// one second of updates to find the setpoint
+#define SETTLE_COUNT 50u
+// ppm per ms of error, and ppm per ms of error per second
+#define KP 40.0
+#define KI 0.4
+
+void CDriftResampler::Reset()
+{
+	hist[0] = hist[1] = hist[2] = 0.0f;
+	pos = -2.0;
+	step = 1.0;
+}
+
+void CDriftResampler::SetRatio(double ratio)
+{
+	const double lo = 1.0 - MAX_DRIFT_PPM * 1.0e-6;
+	const double hi = 1.0 + MAX_DRIFT_PPM * 1.0e-6;
+	if (ratio < lo)
+		ratio = lo;
+	else if (ratio > hi)
+		ratio = hi;
+	step = 1.0 / ratio;
+}
+
+unsigned int CDriftResampler::OutputCount(unsigned int n) const
+{
+	// the same walk as Process(), it has to come out exactly the same
+	unsigned int count = 0u;
+	for (double p=pos; p<double(n)-2.0; p+=step)
+		count++;
+	return count;
+}
+
+unsigned int CDriftResampler::Process(const float *in, unsigned int n, short *out)
+{
+	// x[i] is in[i-3], so the history comes first
+	auto x = [this, in](int i) -> float { return (i < 3) ? hist[i] : in[i-3]; };
+	unsigned int count = 0u;
+	for (; pos<double(n)-2.0; pos+=step)
+	{
+		const int i = int(std::floor(pos));
+		const float t = float(pos - i);
+		const float y0 = x(i+2), y1 = x(i+3), y2 = x(i+4), y3 = x(i+5);
+		// Catmull-Rom
+		const float a = -0.5f*y0 + 1.5f*y1 - 1.5f*y2 + 0.5f*y3;
+		const float b = y0 - 2.5f*y1 + 2.0f*y2 - 0.5f*y3;
+		const float c = -0.5f*y0 + 0.5f*y2;
+		float v = ((a*t + b)*t + c)*t + y1;
+		if (v > 32767.0f)
+			v = 32767.0f;
+		else if (v < -32768.0f)
+			v = -32768.0f;
+		out[count++] = short(lrintf(v));
+	}
+	pos -= n;
+	for (int i=0; i<3; i++)
+		hist[i] = x(int(n) + i);
+	return count;
+}
+
+void CDriftControl::Reset()
+{
+	count = 0u;
+	filtered = setpoint = integral = ppm = 0.0;
+}
+
+double CDriftControl::Update(double fill, double dt)
+{
+	if (count < SETTLE_COUNT)
+	{
+		// hold still until we know where we're starting from
+		setpoint += fill;
+		if (++count == SETTLE_COUNT)
+			filtered = setpoint /= SETTLE_COUNT;
+		return 1.0;
+	}
+	filtered += FILL_ALPHA * (fill - filtered);
+
+	// too much buffered means the sound card is slower than the sender, so make fewer samples
+	const double error = filtered - setpoint;
+	integral += error * dt;
+	// don't wind up past what the resampler can do
+	const double ilimit = MAX_DRIFT_PPM / KI;
+	if (integral > ilimit)
+		integral = ilimit;
+	else if (integral < -ilimit)
+		integral = -ilimit;
+	ppm = KP * error + KI * integral;
+	if (ppm > MAX_DRIFT_PPM)
+		ppm = MAX_DRIFT_PPM;
+	else if (ppm < -MAX_DRIFT_PPM)
+		ppm = -MAX_DRIFT_PPM;
+	return 1.0 - ppm * 1.0e-6;
+}
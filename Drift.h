@@ -0,0 +1,61 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+// the most the sender's clock and the sound card's clock are allowed to disagree, in ppm
+#define MAX_DRIFT_PPM 500.0
+
+// A fractional resampler for clock drift of a few hundred ppm.
+// It uses 4-point cubic interpolation and carries its state from one
+// buffer to the next, so a changing ratio never makes a click.
+class CDriftResampler
+{
+public:
+	CDriftResampler() { Reset(); }
+	void Reset();
+	// output samples per input sample, close to 1.0
+	void SetRatio(double ratio);
+	// how many samples Process() will make from n input samples, n + 2 at most
+	unsigned int OutputCount(unsigned int n) const;
+	unsigned int Process(const float *in, unsigned int n, short *out);
+
+private:
+	float hist[3];	// the last three input samples
+	double pos;		// where the next output sample is, relative to in[0]
+	double step;	// input samples per output sample
+};
+
+// A PI controller that holds the playback buffer fill level where it was
+// when the stream settled, by nudging the resampler ratio.
+class CDriftControl
+{
+public:
+	CDriftControl() { Reset(); }
+	void Reset();
+	// fill is how much audio is buffered ahead of the sound card, in ms,
+	// dt is the time since the last update, in seconds. Returns the ratio.
+	double Update(double fill, double dt);
+	double GetPPM() const { return ppm; }
+	double GetFill() const { return filtered; }
+	double GetSetpoint() const { return setpoint; }
+
+private:
+	unsigned int count;
+	double filtered, setpoint, integral, ppm;
+};
@@ -0,0 +1,57 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <cstring>
+
+#include "EchoBuffer.h"
+
+void CEchoBuffer::Init(unsigned int seconds)
+{
+	capacity = 50u * seconds;	// a C2 3200 frame is 20 ms
+	if (0u == capacity)
+		capacity = 50u;
+	ring.assign(8u * capacity, 0u);
+	head = 0u;
+	count = 0u;
+	overwritten = false;
+}
+
+void CEchoBuffer::Start(bool is_3200)
+{
+	is3200 = is_3200;
+	head = 0u;
+	count = 0u;
+	overwritten = false;
+}
+
+void CEchoBuffer::Add(const uint8_t *frame)
+{
+	memcpy(ring.data() + 8u * head, frame, 8);
+	head = (head + 1u) % capacity;
+	if (count.load(std::memory_order_relaxed) < capacity)
+		count.fetch_add(1u, std::memory_order_release);
+	else
+		overwritten = true;
+}
+
+const uint8_t *CEchoBuffer::Get(unsigned int i) const
+{
+	// when it's full, the oldest frame is at the head
+	const unsigned int first = (count < capacity) ? 0u : head;
+	return ring.data() + 8u * ((first + i) % capacity);
+}
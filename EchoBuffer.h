@@ -0,0 +1,52 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+
+// The codec2 frames of the last echo test. The room is set aside once by
+// Init(), and when a recording runs longer than that, the oldest frames
+// are written over. It's filled by one stage and read by another, never
+// at the same time, so it has no lock. Only the count is atomic, because
+// the GUI asks for it while the buffer is being filled.
+class CEchoBuffer
+{
+public:
+	CEchoBuffer() : capacity(0u), head(0u), count(0u), is3200(false), overwritten(false) {}
+	// room for this many seconds of C2 3200, twice that for C2 1600
+	void Init(unsigned int seconds);
+	// forget the last recording
+	void Start(bool is_3200);
+	// one 8-byte codec2 frame
+	void Add(const uint8_t *frame);
+	unsigned int Size() const { return count.load(std::memory_order_acquire); }
+	bool Is3200() const { return is3200; }
+	// the beginning of the recording was lost
+	bool Overwritten() const { return overwritten; }
+	// the oldest frame is 0
+	const uint8_t *Get(unsigned int i) const;
+
+private:
+	std::vector<uint8_t> ring;
+	unsigned int capacity, head;
+	std::atomic<unsigned int> count;
+	bool is3200, overwritten;
+};
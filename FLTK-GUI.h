@@ -36,5 +36,7 @@
 #include <FL/Fl_Check_Button.H>
 #include <FL/Fl_Return_Button.H>
 #include <FL/Fl_Tabs.H>
+#include <FL/Fl_Spinner.H>
 #include <FL/fl_ask.H>
+#include <FL/Fl_File_Chooser.H>
 #include <FL/Fl_Text_Editor.H>
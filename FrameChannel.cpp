@@ -0,0 +1,112 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "FrameChannel.h"
+
+bool CFrameChannel::Open(unsigned count, CFramePool *framepool)
+{
+	Close();
+	pool = framepool;
+	fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0)
+	{
+		std::cerr << "eventfd() failed: " << strerror(errno) << std::endl;
+		return true;
+	}
+	lanes.clear();
+	for (unsigned i=0; i<count; i++)
+	{
+		lanes.emplace_back(new SLane);
+		lanes.back()->head = lanes.back()->tail = 0u;
+		lanes.back()->dropped = 0ul;
+	}
+	current = 0u;
+	return false;
+}
+
+void CFrameChannel::Close()
+{
+	if (fd >= 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+}
+
+bool CFrameChannel::Push(unsigned lane, CFrameRef &&frame)
+{
+	if (lane >= lanes.size())
+		return true;
+	auto &l = *lanes[lane];
+	const auto tail = l.tail.load(std::memory_order_relaxed);
+	if (! frame || tail - l.head.load(std::memory_order_acquire) >= SLOTS)
+	{
+		l.dropped++;
+		return true;
+	}
+	l.slot[tail % SLOTS] = std::move(frame);
+	l.tail.store(tail + 1u, std::memory_order_seq_cst);
+	// if the consumer had caught up, it may be asleep
+	if (l.head.load(std::memory_order_seq_cst) == tail)
+	{
+		const uint64_t one = 1;
+		if (write(fd, &one, sizeof(one)) < 0 && EAGAIN != errno)
+			std::cerr << "Could not signal the frame channel: " << strerror(errno) << std::endl;
+	}
+	return false;
+}
+
+void CFrameChannel::Clear()
+{
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) < 0 && EAGAIN != errno)
+		std::cerr << "Could not read the frame channel's eventfd: " << strerror(errno) << std::endl;
+}
+
+bool CFrameChannel::Pop(CFrameRef &frame)
+{
+	// take turns, so a busy lane can't hold up the others
+	for (unsigned i=0; i<lanes.size(); i++)
+	{
+		const auto n = (current + i) % lanes.size();
+		auto &l = *lanes[n];
+		const auto head = l.head.load(std::memory_order_relaxed);
+		if (head != l.tail.load(std::memory_order_seq_cst))
+		{
+			frame = std::move(l.slot[head % SLOTS]);
+			l.head.store(head + 1u, std::memory_order_seq_cst);
+			current = (n + 1u) % lanes.size();
+			return false;
+		}
+	}
+	return true;
+}
+
+unsigned long CFrameChannel::GetDropped() const
+{
+	unsigned long count = 0ul;
+	for (const auto &l : lanes)
+		count += l->dropped;
+	return count;
+}
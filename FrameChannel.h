@@ -0,0 +1,82 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "PacketPool.h"
+
+// A one-way path for M17 stream frames between two threads in this process.
+// Each lane is a lock-free ring with one producer thread, so every thread that
+// sends needs a lane of its own, and there is one consumer for all of them.
+// The rings only hold handles to frames from the pool, so a frame is filled in
+// once and then passed along, and the consumer can keep it as long as it wants.
+// The eventfd is written only when a lane goes from empty to not empty, so a
+// burst of frames wakes the consumer once.
+class CFrameChannel
+{
+public:
+	CFrameChannel() : fd(-1), current(0), pool(nullptr) {}
+	~CFrameChannel() { Close(); }
+	// returns true on failure
+	bool Open(unsigned lanes, CFramePool *pool);
+	void Close();
+	// the consumer waits for this to be readable
+	int GetFD() const { return fd; }
+
+	// an empty frame from the pool, it's empty if the pool has run out
+	CFrameRef NewFrame() { return pool->Get(); }
+
+	// from the lane's producer thread, returns true if the lane is full, or
+	// there was no frame, and it was dropped
+	bool Push(unsigned lane, CFrameRef &&frame);
+	// this copies the packet into a frame from the pool
+	template <size_t M> bool Push(unsigned lane, const CTPacket<M> &pack)
+	{
+		auto frame = NewFrame();
+		if (frame)
+			frame->CopyFrom(pack);
+		return Push(lane, std::move(frame));
+	}
+
+	// from the consumer thread: Clear() when the fd is readable, then
+	// Pop() until it returns true because there's nothing left
+	void Clear();
+	bool Pop(CFrameRef &frame);
+
+	unsigned long GetDropped() const;
+
+private:
+	static constexpr unsigned SLOTS = 64;	// a power of two, 2.56 seconds of M17 voice
+
+	using SLane = struct lane_tag
+	{
+		alignas(64) std::atomic<unsigned> head;	// the consumer's
+		alignas(64) std::atomic<unsigned> tail;	// the producer's
+		std::atomic<unsigned long> dropped;
+		CFrameRef slot[SLOTS];
+	};
+
+	int fd;
+	unsigned current;	// the lane to look at first
+	CFramePool *pool;
+	std::vector<std::unique_ptr<SLane>> lanes;
+};
@@ -0,0 +1,55 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <cerrno>
+
+#include "FrameClock.h"
+
+void CFrameClock::Start(unsigned int lead_ms)
+{
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	start.tv_nsec += long(lead_ms) * 1000000l;
+	while (start.tv_nsec >= 1000000000l) {
+		start.tv_sec++;
+		start.tv_nsec -= 1000000000l;
+	}
+	frame = 1ull;
+	stats.Clear();
+}
+
+void CFrameClock::Wait()
+{
+	if (0ull == frame)
+		Start();
+	// the first deadline is the start time itself
+	const unsigned long long ns = (frame - 1ull) * period_ns;
+	struct timespec when;
+	when.tv_sec = start.tv_sec + time_t(ns / 1000000000ull);
+	when.tv_nsec = start.tv_nsec + long(ns % 1000000000ull);
+	if (when.tv_nsec >= 1000000000l) {
+		when.tv_sec++;
+		when.tv_nsec -= 1000000000l;
+	}
+	while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, nullptr))
+		;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	const long long late = (now.tv_sec - when.tv_sec) * 1000000000ll + (now.tv_nsec - when.tv_nsec);
+	stats.Add(late / 1000.0);
+	frame++;
+}
@@ -0,0 +1,45 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <ctime>
+
+#include "Worker.h"
+
+// A frame clock with absolute deadlines on the monotonic clock, so the
+// pacing error doesn't add up from one frame to the next like it would
+// with a relative sleep.
+class CFrameClock
+{
+public:
+	CFrameClock(unsigned int period_ms) : period_ns(period_ms * 1000000ll), frame(0ull) { stats.Clear(); }
+	// the first deadline is lead_ms from now
+	void Start(unsigned int lead_ms = 0u);
+	bool IsStarted() const { return frame > 0ull; }
+	// sleep until the next deadline, then start counting toward the one after it
+	void Wait();
+	// how late we woke up past each deadline, in microseconds
+	const SWakeupStats &GetStats() const { return stats; }
+
+private:
+	const long long period_ns;
+	unsigned long long frame;
+	struct timespec start;
+	SWakeupStats stats;
+};
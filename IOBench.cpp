@@ -0,0 +1,141 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// Compares the packet rate of the gateway's I/O engines. A loop thread
+// echoes 54-byte M17 voice sized datagrams back over the loopback, the way
+// the gateway relays them, while the client keeps a window of them in flight.
+//
+// usage: iobench [packets [window]]
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+
+#include "IOEngine.h"
+
+static int OpenLoopback(struct sockaddr_in &addr)
+{
+	const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || getsockname(fd, (struct sockaddr *)&addr, &len))
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void Echo(CIOEngine *engine, int fd, std::atomic<bool> *running)
+{
+	SIOEvent events[16];
+	while (*running)
+	{
+		const int n = engine->Wait(events, 16);
+		if (n < 0)
+			break;
+		for (int i=0; i<n; i++)
+		{
+			if (events[i].data)
+				engine->Send(fd, events[i].data, events[i].length, events[i].from, events[i].fromlen);
+		}
+	}
+}
+
+// returns true on failure
+static bool Run(bool uring, unsigned long packets, unsigned long window)
+{
+	auto engine = CIOEngine::Make(uring);
+	if (nullptr == engine)
+		return true;
+	struct sockaddr_in server, client;
+	const int sfd = OpenLoopback(server);
+	const int cfd = OpenLoopback(client);
+	if (sfd < 0 || cfd < 0 || engine->AddSocket(sfd, 0))
+	{
+		std::cerr << "Could not set up the loopback sockets: " << strerror(errno) << std::endl;
+		return true;
+	}
+	struct timeval tv = { 1, 0 };	// a lost datagram ends the run
+	setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	std::atomic<bool> running(true);
+	auto loop = std::async(std::launch::async, Echo, engine.get(), sfd, &running);
+
+	unsigned char buf[IO_DGRAM_SIZE];
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, "M17 ", 4);
+	unsigned long sent = 0, received = 0;
+	const auto start = std::chrono::steady_clock::now();
+	while (sent < window && sent < packets)
+	{
+		sendto(cfd, buf, 54, 0, (struct sockaddr *)&server, sizeof(server));
+		sent++;
+	}
+	while (received < packets)
+	{
+		if (recv(cfd, buf, sizeof(buf), 0) < 0)
+			break;
+		received++;
+		if (sent < packets)
+		{
+			sendto(cfd, buf, 54, 0, (struct sockaddr *)&server, sizeof(server));
+			sent++;
+		}
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	running = false;
+	engine->Wake();
+	loop.get();
+	close(sfd);
+	close(cfd);
+
+	std::cout << engine->GetName() << ": " << received << " of " << packets << " packets in " << elapsed.count() << " s, "
+		<< (received / elapsed.count()) << " packets/s, " << (elapsed.count() * 1.0e6 / received) << " us each" << std::endl;
+	return received < packets;
+}
+
+int main(int argc, char *argv[])
+{
+	const unsigned long packets = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 200000ul;
+	const unsigned long window = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 32ul;
+	if (0 == packets || 0 == window)
+	{
+		std::cerr << "usage: " << argv[0] << " [packets [window]]" << std::endl;
+		return 1;
+	}
+	bool failed = Run(false, packets, window);
+#ifdef USE_IO_URING
+	failed = Run(true, packets, window) || failed;
+#else
+	std::cout << "io_uring: not built in, use USE_IO_URING = true in mvoice.mk" << std::endl;
+#endif
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,584 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+
+#include "IOEngine.h"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+std::unique_ptr<CIOEngine> CIOEngine::Make(bool uring)
+{
+	if (uring)
+	{
+#ifdef USE_IO_URING
+		std::unique_ptr<CUringEngine> engine(new CUringEngine);
+		if (! engine->Open())
+			return engine;
+		std::cerr << "io_uring is not available, using epoll" << std::endl;
+#else
+		std::cerr << "mvoice was built without io_uring, using epoll" << std::endl;
+#endif
+	}
+	std::unique_ptr<CEpollEngine> engine(new CEpollEngine);
+	if (engine->Open())
+		return nullptr;
+	return engine;
+}
+
+// the kernel's receive timestamps are on the realtime clock
+static int64_t SteadyOffset()
+{
+	struct timespec real;
+	clock_gettime(CLOCK_REALTIME, &real);
+	const auto steady = std::chrono::steady_clock::now();
+	const int64_t realns = int64_t(real.tv_sec) * 1000000000ll + real.tv_nsec;
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(steady.time_since_epoch()).count() - realns;
+}
+
+static int64_t RXTime(const struct cmsghdr *cmsg, int64_t offset)
+{
+	if (SOL_SOCKET == cmsg->cmsg_level && SCM_TIMESTAMPNS == cmsg->cmsg_type)
+	{
+		struct timespec ts;
+		memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+		return int64_t(ts.tv_sec) * 1000000000ll + ts.tv_nsec + offset;
+	}
+	return 0;
+}
+
+static void EnableTimestamps(int fd)
+{
+	// it's only nice to have, the gateway will stamp the packet itself without it
+	const int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+}
+
+bool CEpollEngine::AddSocket(int fd, int tag)
+{
+	if (reactor.Add(fd, tag))
+		return true;
+	EnableTimestamps(fd);
+	sockets.emplace_back(tag, fd);
+	return false;
+}
+
+void CEpollEngine::RemoveSocket(int fd)
+{
+	Flush();
+	reactor.Remove(fd);
+	for (auto it=sockets.begin(); it!=sockets.end(); it++)
+	{
+		if (it->second == fd)
+		{
+			sockets.erase(it);
+			break;
+		}
+	}
+}
+
+int CEpollEngine::Wait(SIOEvent *events, int max)
+{
+	loop.store(std::this_thread::get_id(), std::memory_order_relaxed);
+	Flush();
+	int tags[MAX_EVENTS];
+	if (max > MAX_EVENTS)
+		max = MAX_EVENTS;
+	const int ready = reactor.Wait(tags, max);
+	if (ready < 0)
+		return -1;
+
+	// the timers and the wake-up go first, so the datagrams can't crowd them out
+	int n = 0;
+	for (int i=0; i<ready; i++)
+	{
+		bool is_socket = false;
+		for (const auto &s : sockets)
+			is_socket = is_socket || s.first == tags[i];
+		if (is_socket)
+			continue;
+		auto &ev = events[n++];
+		ev.tag = tags[i];
+		ev.data = nullptr;
+		ev.length = 0;
+		ev.from = nullptr;
+		ev.fromlen = 0;
+		ev.rxtime = 0;
+	}
+
+	const auto offset = SteadyOffset();
+	for (int i=0; i<ready && n<max; i++)
+	{
+		int fd = -1;
+		for (const auto &s : sockets)
+		{
+			if (s.first == tags[i])
+				fd = s.second;
+		}
+		if (fd < 0)
+			continue;
+		// take everything that's waiting, up to the room that's left, anything more will still be ready next time
+		for (int j=n; j<max; j++)
+		{
+			rxiov[j].iov_base = buffer[j];
+			rxiov[j].iov_len = IO_DGRAM_SIZE;
+			memset(&rxmsg[j], 0, sizeof(struct mmsghdr));
+			rxmsg[j].msg_hdr.msg_name = &from[j];
+			rxmsg[j].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+			rxmsg[j].msg_hdr.msg_iov = &rxiov[j];
+			rxmsg[j].msg_hdr.msg_iovlen = 1;
+			rxmsg[j].msg_hdr.msg_control = rxcontrol[j];
+			rxmsg[j].msg_hdr.msg_controllen = CONTROL_SIZE;
+		}
+		const int count = recvmmsg(fd, &rxmsg[n], unsigned(max - n), MSG_DONTWAIT, nullptr);
+		if (count < 0)
+		{
+			if (EAGAIN != errno && EWOULDBLOCK != errno)
+				std::cerr << "recvmmsg() error: " << strerror(errno) << std::endl;
+			continue;
+		}
+		for (int j=n; j<n+count; j++)
+		{
+			auto &ev = events[j];
+			auto &msg = rxmsg[j].msg_hdr;
+			ev.tag = tags[i];
+			ev.data = buffer[j];
+			ev.length = int(rxmsg[j].msg_len);
+			ev.from = (const struct sockaddr *)&from[j];
+			ev.fromlen = msg.msg_namelen;
+			ev.rxtime = 0;
+			for (auto cmsg=CMSG_FIRSTHDR(&msg); cmsg && 0==ev.rxtime; cmsg=CMSG_NXTHDR(&msg, cmsg))
+				ev.rxtime = RXTime(cmsg, offset);
+		}
+		n += count;
+	}
+	return n;
+}
+
+void CEpollEngine::Send(int fd, const void *buf, size_t size, const struct sockaddr *addr, socklen_t addrlen)
+{
+	if (size > IO_DGRAM_SIZE || addrlen > sizeof(struct sockaddr_storage))
+	{
+		std::cerr << "Can't send a " << size << " byte packet" << std::endl;
+		return;
+	}
+	// only the Wait() thread queues, anyone else sends right now
+	const bool queue_it = std::this_thread::get_id() == loop.load(std::memory_order_relaxed);
+	if (queue_it && MAX_SENDS == queued)
+		Flush();
+	SQueued now;
+	auto &q = queue_it ? queue[queued++] : now;
+	q.fd = fd;
+	q.size = size;
+	memcpy(q.data, buf, size);
+	q.addrlen = addr ? addrlen : 0;
+	if (q.addrlen)
+		memcpy(&q.addr, addr, addrlen);
+	if (! queue_it)
+		SendTo(q);
+}
+
+void CEpollEngine::SendTo(const SQueued &q)
+{
+	const auto rval = sendto(q.fd, q.data, q.size, 0, q.addrlen ? (const struct sockaddr *)&q.addr : nullptr, q.addrlen);
+	if (0 > rval)
+		std::cerr << "sendto() error: " << strerror(errno) << std::endl;
+	else if (size_t(rval) != q.size)
+		std::cerr << "Short write, " << rval << "<" << q.size << std::endl;
+}
+
+void CEpollEngine::Flush()
+{
+	unsigned i = 0;
+	while (i < queued)
+	{
+		// one sendmmsg() for each run of packets on the same socket
+		const int fd = queue[i].fd;
+		unsigned count = 0, first[MAX_SENDS], segments[MAX_SENDS];
+		unsigned j = i;
+		while (j < queued && queue[j].fd == fd)
+		{
+			const auto &q = queue[j];
+			unsigned run = 1;
+			while (gso && j+run < queued && queue[j+run].fd == fd && queue[j+run].size == q.size && queue[j+run].addrlen == q.addrlen && 0 == memcmp(&queue[j+run].addr, &q.addr, q.addrlen))
+				run++;
+			for (unsigned k=0; k<run; k++)
+			{
+				txiov[j+k].iov_base = queue[j+k].data;
+				txiov[j+k].iov_len = queue[j+k].size;
+			}
+			memset(&txmsg[count], 0, sizeof(struct mmsghdr));
+			auto &msg = txmsg[count].msg_hdr;
+			msg.msg_name = q.addrlen ? (void *)&q.addr : nullptr;
+			msg.msg_namelen = q.addrlen;
+			msg.msg_iov = &txiov[j];
+			msg.msg_iovlen = run;
+			if (run > 1)
+			{
+				// the kernel cuts this into datagrams of this size
+				msg.msg_control = txcontrol[count];
+				msg.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+				auto cmsg = CMSG_FIRSTHDR(&msg);
+				cmsg->cmsg_level = IPPROTO_UDP;
+				cmsg->cmsg_type = UDP_SEGMENT;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+				const uint16_t segment = uint16_t(q.size);
+				memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+			}
+			first[count] = j;
+			segments[count++] = run;
+			j += run;
+		}
+
+		unsigned sent = 0;
+		while (sent < count)
+		{
+			const int rval = sendmmsg(fd, &txmsg[sent], count - sent, 0);
+			if (rval > 0)
+			{
+				sent += unsigned(rval);
+				continue;
+			}
+			// this one can't go, so it's sent the usual way
+			if (segments[sent] > 1 && (EIO == errno || EINVAL == errno || ENOPROTOOPT == errno))
+			{
+				std::cout << "UDP GSO isn't available, sending one packet at a time" << std::endl;
+				gso = false;
+				for (unsigned k=0; k<segments[sent]; k++)
+					SendTo(queue[first[sent] + k]);
+			}
+			else
+				std::cerr << "sendmmsg() error: " << strerror(errno) << std::endl;
+			sent++;
+		}
+		i = j;
+	}
+	queued = 0;
+}
+
+#ifdef USE_IO_URING
+
+// what a completion is for, in the top half of its user data
+enum class EUring : uint32_t { recv, poll, wake, send, cancel };
+
+static inline uint64_t UserData(EUring what, uint32_t index)
+{
+	return (uint64_t(what) << 32) | index;
+}
+
+CUringEngine::CUringEngine() : open(false), bufring(nullptr), wakefd(-1), recycle_count(0)
+{
+	for (unsigned i=0; i<SEND_SLOTS; i++)
+		send[i].busy = false;
+}
+
+bool CUringEngine::Open()
+{
+	int rval = io_uring_queue_init(RING_SIZE, &ring, 0);
+	if (rval < 0)
+	{
+		std::cerr << "io_uring_queue_init() failed: " << strerror(-rval) << std::endl;
+		return true;
+	}
+	open = true;
+	// the receive buffers are handed to the kernel once, it picks one for each datagram
+	pool.resize(RECV_BUFFERS * RECV_BUFFER_SIZE);
+	bufring = io_uring_setup_buf_ring(&ring, RECV_BUFFERS, BUFFER_GROUP, 0, &rval);
+	if (nullptr == bufring)
+	{
+		std::cerr << "io_uring_setup_buf_ring() failed: " << strerror(-rval) << std::endl;
+		return true;
+	}
+	for (unsigned i=0; i<RECV_BUFFERS; i++)
+		io_uring_buf_ring_add(bufring, &pool[i * RECV_BUFFER_SIZE], RECV_BUFFER_SIZE, i, io_uring_buf_ring_mask(RECV_BUFFERS), i);
+	io_uring_buf_ring_advance(bufring, RECV_BUFFERS);
+
+	wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wakefd < 0)
+	{
+		std::cerr << "eventfd() failed: " << strerror(errno) << std::endl;
+		return true;
+	}
+	return Arm(EUring::wake, 0u);
+}
+
+CUringEngine::~CUringEngine()
+{
+	if (open)
+	{
+		if (bufring)
+			io_uring_free_buf_ring(&ring, bufring, RECV_BUFFERS, BUFFER_GROUP);
+		io_uring_queue_exit(&ring);
+	}
+	if (wakefd >= 0)
+		close(wakefd);
+}
+
+struct io_uring_sqe *CUringEngine::GetSQE()
+{
+	auto sqe = io_uring_get_sqe(&ring);
+	if (nullptr == sqe)
+	{
+		// the submission queue is full, so this is the one time it costs a syscall
+		io_uring_submit(&ring);
+		sqe = io_uring_get_sqe(&ring);
+	}
+	return sqe;
+}
+
+bool CUringEngine::Arm(EUring what, uint32_t index)
+{
+	auto sqe = GetSQE();
+	if (nullptr == sqe)
+	{
+		std::cerr << "The io_uring submission queue is full" << std::endl;
+		return true;
+	}
+	switch (what)
+	{
+	case EUring::recv:
+		io_uring_prep_recvmsg_multishot(sqe, sockets[index].fd, &sockets[index].msg, 0);
+		sqe->flags |= IOSQE_BUFFER_SELECT;
+		sqe->buf_group = BUFFER_GROUP;
+		break;
+	case EUring::poll:
+		io_uring_prep_poll_multishot(sqe, timers[index].second, POLLIN);
+		break;
+	default:
+		io_uring_prep_poll_multishot(sqe, wakefd, POLLIN);
+		break;
+	}
+	io_uring_sqe_set_data64(sqe, UserData(what, index));
+	return false;
+}
+
+bool CUringEngine::AddSocket(int fd, int tag)
+{
+	// a removed socket's place is used again once its receive has finished
+	uint32_t index = 0;
+	while (index < sockets.size() && (sockets[index].fd >= 0 || sockets[index].armed))
+		index++;
+	if (index == sockets.size())
+		sockets.emplace_back();
+	auto &s = sockets[index];
+	s.fd = fd;
+	s.tag = tag;
+	// this only says how much room the address and the timestamp get in each buffer
+	memset(&s.msg, 0, sizeof(s.msg));
+	s.msg.msg_namelen = sizeof(struct sockaddr_storage);
+	s.msg.msg_controllen = CMSG_SPACE(sizeof(struct timespec));
+	EnableTimestamps(fd);
+	s.armed = ! Arm(EUring::recv, index);
+	return ! s.armed;
+}
+
+void CUringEngine::RemoveSocket(int fd)
+{
+	for (uint32_t i=0; i<sockets.size(); i++)
+	{
+		if (sockets[i].fd != fd)
+			continue;
+		sockets[i].fd = -1;
+		auto sqe = GetSQE();
+		if (sqe)
+		{
+			io_uring_prep_cancel64(sqe, UserData(EUring::recv, i), 0);
+			io_uring_sqe_set_data64(sqe, UserData(EUring::cancel, i));
+		}
+		break;
+	}
+	// what's queued for it has to go out before it's closed
+	io_uring_submit(&ring);
+}
+
+bool CUringEngine::AddTimer(int fd, int tag)
+{
+	timers.emplace_back(tag, fd);
+	return Arm(EUring::poll, uint32_t(timers.size() - 1));
+}
+
+void CUringEngine::Wake()
+{
+	const uint64_t one = 1;
+	if (write(wakefd, &one, sizeof(one)) < 0)
+		std::cerr << "Could not wake the io_uring engine: " << strerror(errno) << std::endl;
+}
+
+int CUringEngine::Wait(SIOEvent *events, int max)
+{
+	loop.store(std::this_thread::get_id(), std::memory_order_relaxed);
+	// what was handed back last time can be used again
+	if (recycle_count)
+	{
+		for (unsigned i=0; i<recycle_count; i++)
+			io_uring_buf_ring_add(bufring, &pool[recycle[i] * RECV_BUFFER_SIZE], RECV_BUFFER_SIZE, recycle[i], io_uring_buf_ring_mask(RECV_BUFFERS), int(i));
+		io_uring_buf_ring_advance(bufring, int(recycle_count));
+		recycle_count = 0;
+	}
+	if (max > int(RECV_BUFFERS))
+		max = int(RECV_BUFFERS);
+
+	// this sends everything queued since the last time, and waits, all in one syscall
+	int rval;
+	do {
+		rval = io_uring_submit_and_wait(&ring, 1);
+	} while (-EINTR == rval);
+	if (rval < 0)
+	{
+		std::cerr << "io_uring_submit_and_wait() error: " << strerror(-rval) << std::endl;
+		return -1;
+	}
+
+	const auto offset = SteadyOffset();
+	int n = 0;
+	struct io_uring_cqe *cqe;
+	while (n < max && 0 == io_uring_peek_cqe(&ring, &cqe))
+	{
+		const auto data = io_uring_cqe_get_data64(cqe);
+		const auto what = EUring(data >> 32);
+		const auto index = uint32_t(data);
+		const auto res = cqe->res;
+		const bool more = 0 != (cqe->flags & IORING_CQE_F_MORE);
+		const bool has_buffer = 0 != (cqe->flags & IORING_CQE_F_BUFFER);
+		const auto bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		io_uring_cqe_seen(&ring, cqe);
+
+		auto &ev = events[n];
+		ev.data = nullptr;
+		ev.length = 0;
+		ev.from = nullptr;
+		ev.fromlen = 0;
+		ev.rxtime = 0;
+		switch (what)
+		{
+		case EUring::recv:
+			if (has_buffer)
+				recycle[recycle_count++] = bid;
+			if (! more)
+				sockets[index].armed = false;
+			if (res < 0)
+			{
+				// ENOBUFS means the gateway is behind, it'll catch up once the buffers are recycled
+				if (-ENOBUFS != res)
+					std::cerr << "io_uring receive error: " << strerror(-res) << std::endl;
+			}
+			else if (has_buffer && sockets[index].fd >= 0)
+			{
+				auto &s = sockets[index];
+				auto out = io_uring_recvmsg_validate(&pool[bid * RECV_BUFFER_SIZE], res, &s.msg);
+				if (out && 0 == (out->flags & MSG_TRUNC))
+				{
+					ev.tag = s.tag;
+					ev.data = (const unsigned char *)io_uring_recvmsg_payload(out, &s.msg);
+					ev.length = int(io_uring_recvmsg_payload_length(out, res, &s.msg));
+					ev.from = (const struct sockaddr *)io_uring_recvmsg_name(out);
+					ev.fromlen = out->namelen;
+					for (auto cmsg=io_uring_recvmsg_cmsg_firsthdr(out, &s.msg); cmsg && 0==ev.rxtime; cmsg=io_uring_recvmsg_cmsg_nexthdr(out, &s.msg, cmsg))
+						ev.rxtime = RXTime(cmsg, offset);
+					n++;
+				}
+			}
+			// a kernel without multishot receives says so here, and there's no point in asking again
+			if (! more && sockets[index].fd >= 0 && (res >= 0 || -ENOBUFS == res))
+				sockets[index].armed = ! Arm(what, index);
+			break;
+		case EUring::poll:
+			if (res < 0)
+			{
+				std::cerr << "io_uring poll error: " << strerror(-res) << std::endl;
+				break;
+			}
+			if (! more)
+				Arm(what, index);
+			ev.tag = timers[index].first;
+			n++;
+			break;
+		case EUring::wake:
+			{
+				uint64_t count;
+				if (read(wakefd, &count, sizeof(count)) < 0 && EAGAIN != errno)
+					std::cerr << "Could not read the wake-up eventfd: " << strerror(errno) << std::endl;
+			}
+			if (! more)
+				Arm(what, index);
+			ev.tag = WAKE_TAG;
+			n++;
+			break;
+		case EUring::send:
+			send[index].busy = false;
+			if (res < 0)
+				std::cerr << "io_uring send error: " << strerror(-res) << std::endl;
+			else if (size_t(res) != send[index].iov.iov_len)
+				std::cerr << "Short write, " << res << "<" << send[index].iov.iov_len << std::endl;
+			break;
+		case EUring::cancel:
+			break;
+		}
+	}
+	return n;
+}
+
+void CUringEngine::Send(int fd, const void *buf, size_t size, const struct sockaddr *addr, socklen_t addrlen)
+{
+	// the ring belongs to the thread in Wait(), anyone else sends the usual way, and so does a packet that's too big
+	if (nullptr == addr)
+		addrlen = 0;
+	if (std::this_thread::get_id() == loop.load(std::memory_order_relaxed) && size <= IO_DGRAM_SIZE && addrlen <= sizeof(struct sockaddr_storage))
+	{
+		for (unsigned i=0; i<SEND_SLOTS; i++)
+		{
+			auto &slot = send[i];
+			if (slot.busy)
+				continue;
+			auto sqe = GetSQE();
+			if (nullptr == sqe)
+				break;
+			memcpy(slot.data, buf, size);
+			if (addrlen)
+				memcpy(&slot.addr, addr, addrlen);
+			slot.iov.iov_base = slot.data;
+			slot.iov.iov_len = size;
+			memset(&slot.msg, 0, sizeof(slot.msg));
+			slot.msg.msg_name = addrlen ? &slot.addr : nullptr;
+			slot.msg.msg_namelen = addrlen;
+			slot.msg.msg_iov = &slot.iov;
+			slot.msg.msg_iovlen = 1;
+			io_uring_prep_sendmsg(sqe, fd, &slot.msg, 0);
+			io_uring_sqe_set_data64(sqe, UserData(EUring::send, i));
+			slot.busy = true;
+			return;
+		}
+	}
+	const auto rval = sendto(fd, buf, size, 0, addr, addrlen);
+	if (0 > rval)
+		std::cerr << "sendto() error: " << strerror(errno) << std::endl;
+	else if (size_t(rval) != size)
+		std::cerr << "Short write, " << rval << "<" << size << std::endl;
+}
+
+#endif	// USE_IO_URING
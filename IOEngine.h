@@ -0,0 +1,190 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <sys/socket.h>
+
+#ifdef USE_IO_URING
+#include <liburing.h>
+#endif
+
+#include "Reactor.h"
+
+// the biggest datagram an engine will hand back, bigger than any M17 packet
+#define IO_DGRAM_SIZE 1024
+
+using SIOEvent = struct ioevent_tag
+{
+	int tag;
+	const unsigned char *data;	// what was received, nullptr if this is a timer or a wake-up
+	int length;
+	const struct sockaddr *from;
+	socklen_t fromlen;
+	int64_t rxtime;	// when the kernel got it, on the CLatency::Now() clock, or zero if it didn't say
+};
+
+// The gateway's I/O. Datagram sockets are read by the engine, so Wait() hands
+// back what arrived, while anything else, like a CDeadline, is only reported
+// as ready. The data is good until the next Wait().
+class CIOEngine
+{
+public:
+	virtual ~CIOEngine() {}
+	// io_uring if it's asked for and it's available, otherwise epoll, returns nullptr on failure
+	static std::unique_ptr<CIOEngine> Make(bool uring);
+	virtual const char *GetName() const = 0;
+	// these return true on failure
+	virtual bool AddSocket(int fd, int tag) = 0;
+	virtual bool AddTimer(int fd, int tag) = 0;
+	// anything queued for it goes out first, then it can be closed
+	virtual void RemoveSocket(int fd) = 0;
+	// from any thread, Wait() will return a WAKE_TAG event
+	virtual void Wake() = 0;
+	// blocks until something is ready, fills in the events and returns how many, or -1 on failure
+	virtual int Wait(SIOEvent *events, int max) = 0;
+	// from the thread that calls Wait(), this may not go out until the next Wait()
+	// a connected socket is sent to with a null addr and a zero addrlen
+	virtual void Send(int fd, const void *buf, size_t size, const struct sockaddr *addr, socklen_t addrlen) = 0;
+
+	static constexpr int WAKE_TAG = CReactor::WAKE_TAG;
+};
+
+// Everything waiting on a socket is read with one recvmmsg(). The sends from
+// the Wait() thread are queued and go out with one sendmmsg() per socket at
+// the next Wait(), and packets of the same size to the same place are sent
+// as one UDP GSO super-packet when the kernel can do that.
+class CEpollEngine : public CIOEngine
+{
+public:
+	CEpollEngine() : queued(0), gso(true) {}
+	bool Open() { return reactor.Open(); }
+	const char *GetName() const { return "epoll"; }
+	bool AddSocket(int fd, int tag);
+	bool AddTimer(int fd, int tag) { return reactor.Add(fd, tag); }
+	void RemoveSocket(int fd);
+	void Wake() { reactor.Wake(); }
+	int Wait(SIOEvent *events, int max);
+	void Send(int fd, const void *buf, size_t size, const struct sockaddr *addr, socklen_t addrlen);
+
+private:
+	static constexpr int MAX_EVENTS = 32;
+	static constexpr unsigned MAX_SENDS = 32;
+	static constexpr unsigned CONTROL_SIZE = 64;	// room for a timestamp or a segment size
+
+	using SQueued = struct queued_tag
+	{
+		int fd;
+		size_t size;
+		struct sockaddr_storage addr;
+		socklen_t addrlen;
+		unsigned char data[IO_DGRAM_SIZE];
+	};
+
+	CReactor reactor;
+	std::vector<std::pair<int, int>> sockets;	// tag and fd
+	std::atomic<std::thread::id> loop { std::thread::id() };	// set by Wait(), read by whoever sends
+	// receiving
+	unsigned char buffer[MAX_EVENTS][IO_DGRAM_SIZE];
+	struct sockaddr_storage from[MAX_EVENTS];
+	unsigned char rxcontrol[MAX_EVENTS][CONTROL_SIZE];
+	struct iovec rxiov[MAX_EVENTS];
+	struct mmsghdr rxmsg[MAX_EVENTS];
+	// sending
+	SQueued queue[MAX_SENDS];
+	unsigned queued;
+	bool gso;
+	unsigned char txcontrol[MAX_SENDS][CONTROL_SIZE];
+	struct iovec txiov[MAX_SENDS];
+	struct mmsghdr txmsg[MAX_SENDS];
+
+	void Flush();
+	void SendTo(const SQueued &q);
+};
+
+#ifdef USE_IO_URING
+
+enum class EUring : uint32_t;
+
+// Multishot receives stay posted on every socket, so the kernel fills the
+// datagrams into a ring of provided buffers without being asked again. The
+// sends from the Wait() thread are queued and go out with the next Wait(),
+// so a burst of them costs one syscall.
+class CUringEngine : public CIOEngine
+{
+public:
+	CUringEngine();
+	~CUringEngine();
+	// returns true on failure
+	bool Open();
+	const char *GetName() const { return "io_uring"; }
+	bool AddSocket(int fd, int tag);
+	bool AddTimer(int fd, int tag);
+	void RemoveSocket(int fd);
+	void Wake();
+	int Wait(SIOEvent *events, int max);
+	void Send(int fd, const void *buf, size_t size, const struct sockaddr *addr, socklen_t addrlen);
+
+private:
+	static constexpr unsigned RING_SIZE = 256;
+	static constexpr unsigned RECV_BUFFERS = 64;	// a power of two
+	// room for the io_uring_recvmsg_out, the address, the timestamp and the datagram
+	static constexpr unsigned RECV_BUFFER_SIZE = 2048;
+	static constexpr int BUFFER_GROUP = 1;
+	static constexpr unsigned SEND_SLOTS = 64;
+
+	using SSocket = struct socket_tag
+	{
+		int fd, tag;	// fd is -1 after it's removed
+		bool armed;		// its multishot receive hasn't finished yet
+		struct msghdr msg;
+	};
+
+	using SSendSlot = struct sendslot_tag
+	{
+		bool busy;
+		unsigned char data[IO_DGRAM_SIZE];
+		struct sockaddr_storage addr;
+		struct iovec iov;
+		struct msghdr msg;
+	};
+
+	struct io_uring ring;
+	bool open;
+	struct io_uring_buf_ring *bufring;
+	std::vector<unsigned char> pool;
+	int wakefd;
+	std::deque<SSocket> sockets;	// the kernel has pointers to their msghdrs
+	std::vector<std::pair<int, int>> timers;	// tag and fd
+	SSendSlot send[SEND_SLOTS];
+	unsigned short recycle[RECV_BUFFERS];
+	unsigned recycle_count;
+	std::atomic<std::thread::id> loop { std::thread::id() };	// set by Wait(), read by whoever sends
+
+	struct io_uring_sqe *GetSQE();
+	bool Arm(EUring what, uint32_t index);
+};
+
+#endif	// USE_IO_URING
@@ -0,0 +1,272 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <cstring>
+#include <cmath>
+
+#include "JitterBuffer.h"
+#include "Drift.h"
+
+// codec2 silence, the same patterns the gateway uses to close a timed out stream
+static const uint8_t silent3200[8] = { 0x01u, 0x00u, 0x09u, 0x43u, 0x9cu, 0xe4u, 0x21u, 0x08u };
+static const uint8_t silent1600[8] = { 0x01u, 0x00u, 0x04u, 0x00u, 0x25u, 0x75u, 0xddu, 0xf2u };
+
+CJitterBuffer::CJitterBuffer() : sid(0u), is3200(true), started(false), stopped(false), have_last(false), repeat_ok(false), next(0), highest(0), lastseq(0), prevseq(0), jitter(0.0), delay(MIN_DELAY), skew(0.0), drift(0.0)
+{
+	memset(slot, 0, sizeof(slot));
+	memset(previous, 0, sizeof(previous));
+	memset(&stats, 0, sizeof(stats));
+}
+
+void CJitterBuffer::Start(uint16_t streamid, bool is_3200)
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	for (auto &s : slot)
+		s.full = false;
+	sid = streamid;
+	is3200 = is_3200;
+	started = stopped = have_last = repeat_ok = false;
+	next = highest = lastseq = prevseq = 0;
+	skew = drift = 0.0;
+	// the jitter estimate is kept, so a new stream starts with what we learned from the last one
+	memset(&stats, 0, sizeof(stats));
+}
+
+void CJitterBuffer::Stop()
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	stopped = true;
+	cv.notify_all();
+}
+
+int64_t CJitterBuffer::Unwrap(uint16_t fn, int64_t ref) const
+{
+	// frame numbers are 15 bits, find the one closest to the reference
+	const int64_t delta = int64_t((fn - (ref & 0x7fff) + 0x4000) & 0x7fff) - 0x4000;
+	return ref + delta;
+}
+
+CJitterBuffer::Clock::time_point CJitterBuffer::PlayoutTime(int64_t seq) const
+{
+	const std::chrono::duration<double, std::milli> offset(seq * PERIOD + delay);
+	return base + std::chrono::duration_cast<Clock::duration>(offset);
+}
+
+double CJitterBuffer::Target() const
+{
+	const double t = PERIOD + 4.0 * jitter;
+	if (t < MIN_DELAY)
+		return MIN_DELAY;
+	if (t > MAX_DELAY)
+		return MAX_DELAY;
+	return t;
+}
+
+unsigned int CJitterBuffer::Depth() const
+{
+	unsigned int d = 0u;
+	for (const auto &s : slot)
+	{
+		if (s.full && s.seq >= next)
+			d++;
+	}
+	return d;
+}
+
+void CJitterBuffer::Put(const CStreamFrame &pack, int64_t stamp)
+{
+	const auto now = Clock::now();
+	std::lock_guard<std::mutex> lck(mtx);
+	if (stopped || pack.GetStreamId() != sid)
+		return;
+
+	const uint16_t fn = pack.GetFrameNumber();
+	int64_t seq;
+	if (started)
+	{
+		seq = Unwrap(fn & 0x7fffu, highest);
+		// RFC 3550: D = difference in arrival time minus difference in send time
+		const std::chrono::duration<double, std::milli> transit(now - prevarrival);
+		const double d = transit.count() - (seq - prevseq) * PERIOD;
+		jitter += (std::fabs(d) - jitter) / 16.0;
+
+		// follow the sender's clock: if packets keep arriving early (or late), move the playout clock a little
+		const std::chrono::duration<double, std::milli> since(now - base);
+		skew += (since.count() - seq * PERIOD - skew) / 64.0;
+		const double limit = PERIOD * MAX_DRIFT_PPM * 1.0e-6;
+		double step = skew / 128.0;
+		if (step > limit)
+			step = limit;
+		else if (step < -limit)
+			step = -limit;
+		base += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(step));
+		skew -= step;
+		drift += (-step / PERIOD * 1.0e6 - drift) / 64.0;
+	}
+	else
+	{
+		// the first packet sets the clock
+		seq = next = highest = fn & 0x7fffu;
+		base = now - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(seq * PERIOD));
+		delay = Target();
+		started = true;
+	}
+	prevarrival = lastarrival = now;
+	prevseq = seq;
+	stats.received++;
+
+	if (fn & 0x8000u)
+	{
+		have_last = true;
+		lastseq = seq;
+	}
+
+	if (seq < next)
+	{
+		stats.late++;	// it's already been concealed
+		cv.notify_all();
+		return;
+	}
+	if (seq - next >= SLOTS)
+	{
+		stats.dropped++;	// way ahead of playout, no room for it
+		return;
+	}
+
+	auto &s = slot[seq % SLOTS];
+	if (s.full && s.seq == seq)
+	{
+		stats.duplicate++;
+		return;
+	}
+	s.seq = seq;
+	s.stamp = stamp;
+	s.full = true;
+	memcpy(s.payload, pack.GetCVoiceData(), 16);
+	if (seq > highest)
+		highest = seq;
+	cv.notify_all();
+}
+
+void CJitterBuffer::Conceal(uint8_t *payload)
+{
+	if (repeat_ok)
+	{
+		// repeating the last good frame once sounds better than a hole
+		memcpy(payload, previous, 16);
+		repeat_ok = false;
+	}
+	else if (is3200)
+	{
+		memcpy(payload, silent3200, 8);
+		memcpy(payload+8, silent3200, 8);
+	}
+	else
+	{
+		memcpy(payload, silent1600, 8);
+		memset(payload+8, 0, 8);
+	}
+}
+
+EJitterFrame CJitterBuffer::Get(uint8_t *payload, int64_t *stamp)
+{
+	if (stamp)
+		*stamp = 0;	// concealed frames have no stamp
+	std::unique_lock<std::mutex> lck(mtx);
+	while (! started && ! stopped)
+		cv.wait(lck);
+
+	if (! stopped)
+	{
+		// adapt the playout delay, one frame at a time
+		const double target = Target();
+		if (target - delay >= PERIOD)
+		{
+			// the network got worse: play a concealment frame to push playout back
+			delay += PERIOD;
+			stats.concealed++;
+			Conceal(payload);
+			return EJitterFrame::concealed;
+		}
+
+		const auto deadline = PlayoutTime(next);
+		while (! stopped && Clock::now() < deadline)
+			cv.wait_until(lck, deadline);
+
+		if (delay - target >= PERIOD && Depth() > 1u)
+		{
+			// the network got better: skip a frame to pull playout forward
+			auto &s = slot[next % SLOTS];
+			if (s.full && s.seq == next && ! (have_last && next == lastseq))
+			{
+				delay -= PERIOD;
+				s.full = false;
+				stats.dropped++;
+				next++;
+			}
+		}
+	}
+
+	if (stopped)
+	{
+		repeat_ok = false;
+		Conceal(payload);
+		return EJitterFrame::stopped;
+	}
+
+	EJitterFrame rval;
+	auto &s = slot[next % SLOTS];
+	if (s.full && s.seq == next)
+	{
+		memcpy(payload, s.payload, 16);
+		memcpy(previous, s.payload, 16);
+		repeat_ok = true;
+		if (stamp)
+			*stamp = s.stamp;
+		s.full = false;
+		rval = (have_last && next == lastseq) ? EJitterFrame::last : EJitterFrame::voice;
+	}
+	else if ((have_last && next >= lastseq) || Clock::now() - lastarrival > std::chrono::seconds(3))
+	{
+		// the end of the stream was lost, or the stream stalled and the gateway didn't close it
+		repeat_ok = false;
+		Conceal(payload);
+		rval = EJitterFrame::last;
+	}
+	else
+	{
+		stats.lost++;
+		stats.concealed++;
+		Conceal(payload);
+		rval = EJitterFrame::concealed;
+	}
+	next++;
+	return rval;
+}
+
+SJitterStats CJitterBuffer::GetStats()
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	SJitterStats s = stats;
+	s.depth = Depth();
+	s.jitter = jitter;
+	s.target = Target();
+	s.delay = delay;
+	s.drift = drift;
+	return s;
+}
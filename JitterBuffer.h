@@ -0,0 +1,91 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "Packet.h"
+
+// what Get() handed back
+enum class EJitterFrame { voice, concealed, last, stopped };
+
+using SJitterStats = struct jitterstats_tag
+{
+	unsigned int received, late, lost, duplicate, concealed, dropped;
+	unsigned int depth;	// frames buffered right now
+	double jitter;		// interarrival jitter estimate, in ms
+	double target;		// the playout delay we are aiming for, in ms
+	double delay;		// the playout delay we are actually using, in ms
+	double drift;		// how fast the sender's clock is running compared to ours, in ppm
+};
+
+// An adaptive playout buffer for incoming M17 voice frames.
+// Put() is called as packets arrive from the gateway and Get() is called by
+// the decoder, which is handed one 16-byte payload every 40 ms. Frames are
+// keyed on their frame number, so reordered frames are put back in order
+// and missing frames are concealed. The playout delay follows an RFC 3550
+// style interarrival jitter estimate that is carried from stream to stream.
+// The playout clock slowly follows the sender's clock, so a sender whose
+// clock is a little fast or slow doesn't make the buffer fill up or run dry.
+class CJitterBuffer
+{
+public:
+	CJitterBuffer();
+	void Start(uint16_t streamid, bool is_3200);
+	// the stamp is handed back by Get() when the frame is played out
+	void Put(const CStreamFrame &pack, int64_t stamp = 0);
+	EJitterFrame Get(uint8_t *payload, int64_t *stamp = nullptr);
+	void Stop();
+	SJitterStats GetStats();
+
+private:
+	using Clock = std::chrono::steady_clock;
+	static constexpr unsigned int SLOTS = 64;	// 2.56 seconds of M17 voice
+	static constexpr double PERIOD = 40.0;		// ms per M17 stream frame
+	static constexpr double MIN_DELAY = 40.0;
+	static constexpr double MAX_DELAY = 1000.0;
+
+	using SSlot = struct slot_tag
+	{
+		int64_t seq, stamp;
+		bool full;
+		uint8_t payload[16];
+	};
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	SSlot slot[SLOTS];
+	uint16_t sid;
+	bool is3200, started, stopped, have_last, repeat_ok;
+	int64_t next, highest, lastseq, prevseq;
+	Clock::time_point base, prevarrival, lastarrival;
+	double jitter, delay;
+	double skew, drift;	// smoothed arrival lateness in ms, and the playout clock correction in ppm
+	uint8_t previous[16];
+	SJitterStats stats;
+
+	int64_t Unwrap(uint16_t fn, int64_t ref) const;
+	Clock::time_point PlayoutTime(int64_t seq) const;
+	double Target() const;
+	void Conceal(uint8_t *payload);
+	unsigned int Depth() const;
+};
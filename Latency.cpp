@@ -0,0 +1,207 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+#include "Latency.h"
+
+// buckets are a quarter of an octave wide, in microseconds, so 96 buckets goes past 16 seconds
+#define LATENCY_BUCKETS 96
+#define STAGE_COUNT unsigned(ELatencyStage::count)
+#define MARK_SLOTS 64u
+
+using SHistogram = struct histogram_tag
+{
+	std::atomic<uint32_t> bucket[LATENCY_BUCKETS];
+	std::atomic<uint64_t> count, sum, max;		// sum and max are in ns
+	std::atomic<uint64_t> wcount, wsum, wmax;	// the same, but since the last Summary()
+};
+
+static SHistogram hist[STAGE_COUNT];
+static std::atomic<uint64_t> txorigin[MARK_SLOTS], txstamp[MARK_SLOTS];
+
+static const char *stagename[STAGE_COUNT] = { "txQueue", "txCondition", "txEncode", "txC2Queue", "txPacket", "txIPC", "txSend", "txTotal", "rxIPC", "rxBuffer", "rxDecode", "rxQueue", "rxWrite", "rxDevice", "rxTotal" };
+static const char *shortname[STAGE_COUNT] = { "q", "cond", "enc", "c2q", "pkt", "ipc", "send", "total", "ipc", "jb", "dec", "q", "wr", "dev", "total" };
+
+using SXrunTotals = struct xruntotals_tag
+{
+	std::atomic<uint64_t> opened, xruns, shorts, errors, dropped, recoveries, recovery_sum, recovery_max;	// the times are in us
+};
+
+static SXrunTotals xruntotal[2];	// capture, then playback
+
+static void UpdateMax(std::atomic<uint64_t> &m, uint64_t v)
+{
+	auto old = m.load(std::memory_order_relaxed);
+	while (v > old && ! m.compare_exchange_weak(old, v, std::memory_order_relaxed))
+		;
+}
+
+// the upper 16 bits hold the frame number, the lower 48 bits hold microseconds
+static uint64_t Pack(uint16_t fn, int64_t ns)
+{
+	return (uint64_t(fn & 0x7fffu) << 48) | (uint64_t(ns / 1000) & 0xffffffffffffull);
+}
+
+static bool Unpack(uint64_t v, uint16_t fn, int64_t &ns)
+{
+	if (v >> 48 != (fn & 0x7fffu) || 0 == (v & 0xffffffffffffull))
+		return false;
+	ns = int64_t(v & 0xffffffffffffull) * 1000;
+	return true;
+}
+
+static double BucketTop(unsigned int i)
+{
+	return std::pow(2.0, (i + 1) / 4.0);	// in us
+}
+
+int64_t CLatency::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CLatency::Record(ELatencyStage stage, int64_t ns)
+{
+	if (ns < 0)
+		ns = 0;
+	auto &h = hist[unsigned(stage)];
+	int i = int(4.0 * std::log2(1.0 + ns / 1000.0));
+	if (i >= LATENCY_BUCKETS)
+		i = LATENCY_BUCKETS - 1;
+	h.bucket[i].fetch_add(1u, std::memory_order_relaxed);
+	h.count.fetch_add(1u, std::memory_order_relaxed);
+	h.sum.fetch_add(uint64_t(ns), std::memory_order_relaxed);
+	UpdateMax(h.max, uint64_t(ns));
+	h.wcount.fetch_add(1u, std::memory_order_relaxed);
+	h.wsum.fetch_add(uint64_t(ns), std::memory_order_relaxed);
+	UpdateMax(h.wmax, uint64_t(ns));
+}
+
+void CLatency::MarkTX(uint16_t fn, int64_t origin, int64_t stamp)
+{
+	txorigin[fn % MARK_SLOTS].store(Pack(fn, origin), std::memory_order_relaxed);
+	txstamp[fn % MARK_SLOTS].store(Pack(fn, stamp), std::memory_order_release);
+}
+
+bool CLatency::FindTX(uint16_t fn, int64_t &origin, int64_t &stamp)
+{
+	const auto s = txstamp[fn % MARK_SLOTS].load(std::memory_order_acquire);
+	const auto o = txorigin[fn % MARK_SLOTS].load(std::memory_order_relaxed);
+	return Unpack(s, fn, stamp) && Unpack(o, fn, origin);
+}
+
+void CLatency::Summary(bool tx, char *line, size_t size)
+{
+	const unsigned first = unsigned(tx ? ELatencyStage::txQueue : ELatencyStage::rxIPC);
+	const unsigned last  = unsigned(tx ? ELatencyStage::txTotal : ELatencyStage::rxTotal);
+	int n = snprintf(line, size, "%s latency ms avg/max:", tx ? "TX" : "RX");
+	for (unsigned i=first; i<=last && n>0 && size_t(n)<size; i++)
+	{
+		auto &h = hist[i];
+		const auto c = h.wcount.exchange(0u);
+		const auto s = h.wsum.exchange(0u);
+		const auto m = h.wmax.exchange(0u);
+		if (c)
+			n += snprintf(line+n, size-n, " %s %.1f/%.1f", shortname[i], 1.0e-6 * s / c, 1.0e-6 * m);
+	}
+	if (n > 0 && size_t(n) < size-1)
+	{
+		line[n++] = '\n';
+		line[n] = 0;
+	}
+}
+
+void CLatency::AddXruns(bool capture, const SXrunStats &stats)
+{
+	auto &t = xruntotal[capture ? 0 : 1];
+	t.opened.fetch_add(1u, std::memory_order_relaxed);
+	t.xruns.fetch_add(stats.xruns, std::memory_order_relaxed);
+	t.shorts.fetch_add(stats.shorts, std::memory_order_relaxed);
+	t.errors.fetch_add(stats.errors, std::memory_order_relaxed);
+	t.dropped.fetch_add(stats.dropped, std::memory_order_relaxed);
+	t.recoveries.fetch_add(stats.recoveries, std::memory_order_relaxed);
+	t.recovery_sum.fetch_add(uint64_t(stats.recovery_sum), std::memory_order_relaxed);
+	UpdateMax(t.recovery_max, uint64_t(stats.recovery_max));
+}
+
+bool CLatency::Export(const std::string &path)
+{
+	nlohmann::json j;
+	for (unsigned i=0; i<2; i++)
+	{
+		const auto &t = xruntotal[i];
+		auto &d = j["soundcard"][i ? "playback" : "capture"];
+		d["opened"] = t.opened.load();
+		d["xruns"] = t.xruns.load();
+		d["short"] = t.shorts.load();
+		d["errors"] = t.errors.load();
+		d["dropped_frames"] = t.dropped.load();
+		const auto r = t.recoveries.load();
+		d["recoveries"] = r;
+		d["recovery_avg_us"] = r ? double(t.recovery_sum.load()) / r : 0.0;
+		d["recovery_max_us"] = t.recovery_max.load();
+	}
+	for (unsigned i=0; i<STAGE_COUNT; i++)
+	{
+		auto &h = hist[i];
+		const auto c = h.count.load();
+		auto &s = j[stagename[i]];
+		s["count"] = c;
+		s["avg_us"] = c ? 1.0e-3 * h.sum.load() / c : 0.0;
+		s["max_us"] = 1.0e-3 * h.max.load();
+		// the upper edge of each non-empty bucket and how many are in it
+		auto &b = s["buckets"];
+		b = nlohmann::json::array();
+		for (unsigned k=0; k<LATENCY_BUCKETS; k++)
+		{
+			const auto v = h.bucket[k].load();
+			if (v)
+				b.push_back({ BucketTop(k), v });
+		}
+		// percentiles from the histogram
+		const double pct[3] = { 0.5, 0.95, 0.99 };
+		const char *pname[3] = { "p50_us", "p95_us", "p99_us" };
+		for (int p=0; p<3; p++)
+		{
+			uint64_t sum = 0u;
+			double top = 0.0;
+			for (unsigned k=0; c && k<LATENCY_BUCKETS; k++)
+			{
+				sum += h.bucket[k].load();
+				if (sum >= pct[p] * c)
+				{
+					top = BucketTop(k);
+					break;
+				}
+			}
+			s[pname[p]] = top;
+		}
+	}
+	std::ofstream file(path, std::ofstream::out | std::ofstream::trunc);
+	if (! file.is_open())
+		return true;
+	file << j.dump(1, '\t') << std::endl;
+	file.close();
+	return false;
+}
@@ -0,0 +1,84 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Every stage a frame goes through on its way out to the network, or in to the
+// sound card. "Total" is from the mic read to the sendto(), or from the recvfrom()
+// to the moment the sound card will play it.
+enum class ELatencyStage {
+	txQueue,	// audio frame waiting for the encoder
+	txCondition,	// the high-pass filter, AGC and limiter
+	txEncode,	// codec2_encode()
+	txC2Queue,	// codec2 frame waiting to be packetized
+	txPacket,	// building the M17 frame and writing it to the gateway
+	txIPC,		// crossing to the gateway thread
+	txSend,		// gateway to sendto()
+	txTotal,
+	rxIPC,		// crossing from the gateway thread to the audio manager
+	rxBuffer,	// waiting in the jitter buffer
+	rxDecode,	// codec2_decode()
+	rxQueue,	// audio frame waiting for the sound card
+	rxWrite,	// snd_pcm_writei()
+	rxDevice,	// what was already queued in the sound card
+	rxTotal,
+	count
+};
+
+// what went wrong with a sound card while it was open
+using SXrunStats = struct xrunstats_tag
+{
+	unsigned int xruns;		// overruns or underruns
+	unsigned int shorts;	// reads or writes that didn't move every frame
+	unsigned int errors;	// anything else
+	unsigned long dropped;	// frames that were lost, or replaced with silence
+	unsigned int recoveries;
+	double recovery_sum, recovery_max;	// how long it took to get going again, in us
+	const char *lasterror;	// what the last of the errors was, nullptr if there were none
+
+	void Clear() { xruns = shorts = errors = recoveries = 0u; dropped = 0ul; recovery_sum = recovery_max = 0.0; lasterror = nullptr; }
+	bool Any() const { return xruns || shorts || errors; }
+	void AddRecovery(double us) { recoveries++; recovery_sum += us; if (us > recovery_max) recovery_max = us; }
+};
+
+// Lock-free latency histograms shared by the audio manager and the gateway.
+// Record() can be called from any thread, it's only a few atomic adds.
+class CLatency
+{
+public:
+	// steady clock, in nanoseconds
+	static int64_t Now();
+	static void Record(ELatencyStage stage, int64_t ns);
+	static void Since(ELatencyStage stage, int64_t from) { if (from) Record(stage, Now() - from); }
+
+	// stamps for frames the audio manager hands to the gateway, keyed on the frame number
+	// received frames carry their own, see CTPacket::GetRXTime()
+	static void MarkTX(uint16_t fn, int64_t origin, int64_t stamp);
+	static bool FindTX(uint16_t fn, int64_t &origin, int64_t &stamp);
+
+	// average/max in ms of each stage since the last summary
+	static void Summary(bool tx, char *line, size_t size);
+	// sound card totals for Export(), once a device is closed
+	static void AddXruns(bool capture, const SXrunStats &stats);
+	// all the histograms and the sound card totals as json, returns true on failure
+	static bool Export(const std::string &path);
+};
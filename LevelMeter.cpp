@@ -0,0 +1,172 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "LevelMeter.h"
+
+// the largest magnitude, the count of samples over 16383 and the sum of squares of the odd samples
+static void FrameStats(const short *in, unsigned int &peak, unsigned int &clip, uint64_t &ss)
+{
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i half = _mm_set1_epi16(16383);
+	const __m128i odd = _mm_set1_epi32(0xffff0000);
+	__m128i max = zero, over = zero, sum = zero;
+	for (unsigned int i=0; i<160; i+=8) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+		// saturating, so -32768 becomes 32767
+		const __m128i a = _mm_max_epi16(x, _mm_subs_epi16(zero, x));
+		max = _mm_max_epi16(max, a);
+		// each compare is -1 where it's true
+		over = _mm_sub_epi16(over, _mm_cmpgt_epi16(a, half));
+		// only the odd samples are squared, every 32-bit lane is one square
+		const __m128i sq = _mm_madd_epi16(_mm_and_si128(x, odd), x);
+		sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(sq, zero));
+		sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(sq, zero));
+	}
+	int16_t m[8], o[8];
+	uint64_t s[2];
+	_mm_storeu_si128((__m128i *)m, max);
+	_mm_storeu_si128((__m128i *)o, over);
+	_mm_storeu_si128((__m128i *)s, sum);
+	peak = clip = 0u;
+	for (unsigned int i=0; i<8; i++) {
+		if (unsigned(m[i]) > peak)
+			peak = m[i];
+		clip += o[i];
+	}
+	ss = s[0] + s[1];
+#elif defined(__ARM_NEON)
+	const int16x8_t half = vdupq_n_s16(16383);
+	int16x8_t max = vdupq_n_s16(0);
+	uint16x8_t over = vdupq_n_u16(0);
+	uint64x2_t sum = vdupq_n_u64(0);
+	for (unsigned int i=0; i<160; i+=16) {
+		// val[0] has the even samples and val[1] has the odd ones
+		const int16x8x2_t x = vld2q_s16(in + i);
+		const int16x8_t a0 = vqabsq_s16(x.val[0]), a1 = vqabsq_s16(x.val[1]);
+		max = vmaxq_s16(max, vmaxq_s16(a0, a1));
+		over = vsubq_u16(over, vcgtq_s16(a0, half));
+		over = vsubq_u16(over, vcgtq_s16(a1, half));
+		sum = vpadalq_u32(sum, vreinterpretq_u32_s32(vmull_s16(vget_low_s16(x.val[1]), vget_low_s16(x.val[1]))));
+		sum = vpadalq_u32(sum, vreinterpretq_u32_s32(vmull_s16(vget_high_s16(x.val[1]), vget_high_s16(x.val[1]))));
+	}
+	int16_t m[8];
+	uint16_t o[8];
+	uint64_t s[2];
+	vst1q_s16(m, max);
+	vst1q_u16(o, over);
+	vst1q_u64(s, sum);
+	peak = clip = 0u;
+	for (unsigned int i=0; i<8; i++) {
+		if (unsigned(m[i]) > peak)
+			peak = m[i];
+		clip += o[i];
+	}
+	ss = s[0] + s[1];
+#else
+	peak = clip = 0u;
+	ss = 0u;
+	for (unsigned int i=0; i<160; i++) {
+		unsigned int a = std::abs(int(in[i]));
+		if (a > 32767u)
+			a = 32767u;	// the same as the saturating versions
+		if (a > peak)
+			peak = a;
+		if (a > 16383u)
+			clip++;
+		if (i % 2)
+			ss += uint64_t(a) * a;	// every other point will do
+	}
+#endif
+}
+
+CLevelMeter::CLevelMeter() : seq(0u), count(0u), clip(0u), frames(0u), ss(0.0), peak(0.0), rms(0.0)
+{
+	totals.frames = 0u;
+	Reset();
+}
+
+void CLevelMeter::Reset()
+{
+	totals.count = totals.clip = 0u;
+	totals.ss = totals.peak = totals.rms = 0.0;
+	Publish();
+}
+
+void CLevelMeter::Update(const short *frame)
+{
+	unsigned int p, c;
+	uint64_t s;
+	FrameStats(frame, p, c, s);
+	totals.count += 160u;
+	totals.clip += c;
+	totals.ss += double(s);
+	totals.peak = p;
+	totals.rms = std::sqrt(s / 80.0);
+	totals.frames++;
+	Publish();
+}
+
+void CLevelMeter::Skip()
+{
+	totals.count += 160u;
+	totals.frames++;
+	Publish();
+}
+
+void CLevelMeter::Publish()
+{
+	// odd while the snapshot is being written
+	const auto s = seq.load(std::memory_order_relaxed);
+	seq.store(s + 1u, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	count.store(totals.count, std::memory_order_relaxed);
+	clip.store(totals.clip, std::memory_order_relaxed);
+	frames.store(totals.frames, std::memory_order_relaxed);
+	ss.store(totals.ss, std::memory_order_relaxed);
+	peak.store(totals.peak, std::memory_order_relaxed);
+	rms.store(totals.rms, std::memory_order_relaxed);
+	seq.store(s + 2u, std::memory_order_release);
+}
+
+SLevels CLevelMeter::Read() const
+{
+	SLevels l;
+	uint32_t before, after;
+	do {
+		before = seq.load(std::memory_order_acquire);
+		l.count = count.load(std::memory_order_relaxed);
+		l.clip = clip.load(std::memory_order_relaxed);
+		l.frames = frames.load(std::memory_order_relaxed);
+		l.ss = ss.load(std::memory_order_relaxed);
+		l.peak = peak.load(std::memory_order_relaxed);
+		l.rms = rms.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = seq.load(std::memory_order_relaxed);
+	} while ((before & 1u) || before != after);
+	return l;
+}
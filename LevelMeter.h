@@ -0,0 +1,55 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+using SLevels = struct levels_tag
+{
+	unsigned int count;	// samples since Reset()
+	unsigned int clip;	// samples within 6 dB of full scale, since Reset()
+	double ss;			// sum of the squares of every other sample, since Reset()
+	double peak, rms;	// of the latest frame, where full scale is 32768
+	uint32_t frames;	// goes up with every frame, so a reader can tell if the audio is flowing
+};
+
+// Level, peak and clip statistics of 20 ms frames of 8000 samples/sec audio.
+// One audio thread at a time calls Update() and any other thread can call
+// Read() as often as it likes. The snapshot is published with a seqlock,
+// so the audio thread never waits for a reader.
+class CLevelMeter
+{
+public:
+	CLevelMeter();
+	// the start of an over
+	void Reset();
+	void Update(const short *frame);
+	// a frame that is counted but not measured
+	void Skip();
+	SLevels Read() const;
+
+private:
+	SLevels totals;	// only for the writer
+	std::atomic<uint32_t> seq;
+	std::atomic<unsigned int> count, clip, frames;
+	std::atomic<double> ss, peak, rms;
+
+	void Publish();
+};
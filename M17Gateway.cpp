@@ -16,7 +16,7 @@
  *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
-#include <sys/select.h>
+#include <pthread.h>
 
 #include <string>
 #include <sstream>
@@ -26,15 +26,24 @@
 #include <cstring>
 
 #include "M17Gateway.h"
+#include "Worker.h"
+#include "Latency.h"
 
-CM17Gateway::CM17Gateway() : CBase()
+// in seconds
+#define LINK_TIMEOUT 5.0
+#define PING_TIMEOUT 30.0
+#define STREAM_TIMEOUT 2.0
+
+// what the I/O engine hands back
+enum EGatewayEvent { evIPv4, evIPv6, evReflector, evAudio, evLink, evStream, evReport };
+
+CM17Gateway::CM17Gateway() : CBase(), AM2M17(nullptr), M172AM(nullptr), linkConnected(false)
 {
 	keep_running = false; // not running initially. this will be set to true in CMainWindow
 }
 
 CM17Gateway::~CM17Gateway()
 {
-	AM2M17.Close();
 	ipv4.Close();
 	ipv6.Close();
 }
@@ -49,23 +58,32 @@ void CM17Gateway::ReleaseLock()
 	streamLock.unlock();
 }
 
-bool CM17Gateway::Init(const CFGDATA &cfgdata)
+bool CM17Gateway::Init(const CFGDATA &cfgdata, CFrameChannel *am2m17, CFrameChannel *m172am)
 {
-	currentStream.header.Initialize(54u, true);
+	AM2M17 = am2m17;
+	M172AM = m172am;
+	streams.Clear();
 	mlink.state = ELinkState::unlinked;
-	if (AM2M17.Open("am2m17"))
+	engine = CIOEngine::Make(cfgdata.bGatewayIOUring);
+	if (nullptr == engine)
+		return true;
+	std::cout << "The gateway is using " << engine->GetName() << std::endl;
+	if (linkDeadline.Open() || streamDeadline.Open() || reportDeadline.Open())
+		return true;
+	if (engine->AddTimer(AM2M17->GetFD(), evAudio))
 		return true;
-	M172AM.SetUp("m172am");
 	if (cfgdata.eNetType != EInternetType::ipv6only)
 	{
-		if (ipv4.Open(CSockAddress(AF_INET, 0, "any")))  // use ephemeral port
+		if (ipv4.Open(CSockAddress(AF_INET, 0, "any")) || engine->AddSocket(ipv4.GetSocket(), evIPv4))  // use ephemeral port
 			return true;
 	}
 	if (cfgdata.eNetType != EInternetType::ipv4only)
 	{
-		if (ipv6.Open(CSockAddress(AF_INET6, 0, "any"))) // use ephemeral port
+		if (ipv6.Open(CSockAddress(AF_INET6, 0, "any")) || engine->AddSocket(ipv6.GetSocket(), evIPv6)) // use ephemeral port
 			return true;
 	}
+	if (engine->AddTimer(linkDeadline.GetFD(), evLink) || engine->AddTimer(streamDeadline.GetFD(), evStream) || engine->AddTimer(reportDeadline.GetFD(), evReport))
+		return true;
 	keep_running = true;
 	CConfigure config;
 	config.CopyFrom(cfgdata);
@@ -73,242 +91,351 @@ bool CM17Gateway::Init(const CFGDATA &cfgdata)
 	return false;
 }
 
-void CM17Gateway::LinkCheck()
+// the link deadline is for the link request while linking, and for the reflector's pings once it's linked
+void CM17Gateway::LinkTimeout()
 {
-	if (mlink.receivePingTimer.time() > 30) // is the reflector okay?
+	if (ELinkState::linked == mlink.state)
 	{
 		// looks like we lost contact
 		SendLog("Disconnected from %s, TIMEOUT...\n", mlink.cs.GetCS().c_str());
 		mlink.state = ELinkState::unlinked;
+		CloseLink();
 		mlink.addr.Clear();
 	}
+	else if (ELinkState::linking == mlink.state)
+	{
+		SendLog("Link request to %s timeout.\n", mlink.cs.GetCS().c_str());
+		mlink.state = ELinkState::unlinked;
+		CloseLink();
+	}
+}
+
+void CM17Gateway::OpenLink()
+{
+	CloseLink();
+	// if it can't be opened, the reflector is reached on the shared socket like anything else
+	if (linkSock.Open(CSockAddress(mlink.addr.GetFamily(), 0, "any")))
+		return;
+	if (engine->AddSocket(linkSock.GetSocket(), evReflector))
+		linkSock.Close();
+}
+
+void CM17Gateway::CloseLink()
+{
+	if (linkSock.GetSocket() >= 0)
+	{
+		engine->RemoveSocket(linkSock.GetSocket());
+		linkSock.Close();
+	}
+	linkConnected = false;
+}
+
+// the streams that were due by now are closed, as if their last frame came in
+void CM17Gateway::StreamTimeouts(int64_t now)
+{
+	for (auto stream=streams.Expired(now); stream; stream=streams.Expired(now))
+	{
+		StreamTimeout(*stream);
+		CloseStream(stream);
+	}
+	// the deadline is only moved when it goes off, so a frame doesn't cost a system call
+	if (streams.Count())
+		streamDeadline.Arm(double(streams.NextDue() - now) / 1.0e9);
 }
 
-void CM17Gateway::StreamTimeout()
+void CM17Gateway::StreamTimeout(const SStream &stream)
 {
+	auto frame = M172AM->NewFrame();
+	if (! frame)
+		return;
+	frame->CopyFrom(stream.header);
+	frame->SetRXTime(0);	// it never came off the network
+	frame->SetStreamKey(stream.key);
 	// set the frame number
-	uint16_t fn = (currentStream.header.GetFrameNumber() + 1) % 0x8000u;
-	currentStream.header.SetFrameNumber(fn | 0x8000u);
+	frame->SetFrameNumber(stream.next | 0x8000u);
 	// fill in a silent codec2
-	switch (currentStream.header.GetFrameType() & 0x6u) {
+	switch (frame->GetFrameType() & 0x6u) {
 	case 0x4u:
 		{ //3200
 			uint8_t silent[] = { 0x01u, 0x00u, 0x09u, 0x43u, 0x9cu, 0xe4u, 0x21u, 0x08u };
-			memcpy(currentStream.header.GetVoiceData(),   silent, 8);
-			memcpy(currentStream.header.GetVoiceData(false), silent, 8);
+			memcpy(frame->GetVoiceData(),   silent, 8);
+			memcpy(frame->GetVoiceData(false), silent, 8);
 		}
 		break;
 	case 0x6u:
 		{ // 1600
 			uint8_t silent[] = { 0x01u, 0x00u, 0x04u, 0x00u, 0x25u, 0x75u, 0xddu, 0xf2u };
-			memcpy(currentStream.header.GetVoiceData(), silent, 8);
+			memcpy(frame->GetVoiceData(), silent, 8);
 		}
 		break;
 	default:
 		break;
 	}
 	// calculate the crc
-	currentStream.header.CalcCRC();
+	frame->CalcCRC();
 	// send the packet
-	M172AM.Write(currentStream.header.GetCData(), currentStream.header.GetSize());
-	// close the stream;
-	currentStream.header.SetStreamId(0u);
-	streamLock.unlock();
+	M172AM->Push(0u, std::move(frame));
 }
 
+void CM17Gateway::CloseStream(SStream *stream)
+{
+	const auto &st = stream->stats;
+	SendLog("Close stream id=0x%04x, duration=%.2f sec\n", stream->sid, 0.04f * (0x7fffu & stream->header.GetFrameNumber()));
+	if (st.lost || st.late)
+		std::cout << Now() << " Stream 0x" << std::hex << stream->sid << std::dec << " from " << stream->from << ": " << st.frames << " frames, " << st.lost << " lost, " << st.late << " late" << std::endl;
+	streams.Remove(stream);
+	if (0u == streams.Count())
+	{
+		streamDeadline.Disarm();
+		streamLock.unlock();
+	}
+}
+
+// the link socket belongs to the gateway thread, so the message waits there for Process() to send it
 void CM17Gateway::SendMessage(const CPacket &pack)
 {
-	Write(pack.GetCData(), pack.GetSize(), destination);
+	if (outbox.Push(pack))
+	{
+		std::cerr << "The gateway's outbox is full, the message wasn't sent" << std::endl;
+		return;
+	}
+	if (engine)
+		engine->Wake();
+}
+
+void CM17Gateway::Stop()
+{
+	keep_running = false;
+	if (engine)
+		engine->Wake();
 }
 
 void CM17Gateway::Process()
 {
-	fd_set fdset;
-	timeval tv;
-	int max_nfds = 0;
-	const auto ip4fd = ipv4.GetSocket();
-	const auto ip6fd = ipv6.GetSocket();
-	const auto amfd = AM2M17.GetFD();
-	if ((EInternetType::ipv6only != cfg.eNetType) && (ip4fd > max_nfds))
-		max_nfds = ip4fd;
-	if ((EInternetType::ipv4only != cfg.eNetType) && (ip6fd > max_nfds))
-		max_nfds = ip6fd;
-	if (amfd > max_nfds)
-		max_nfds = amfd;
+	CWorker::SetScheduling(pthread_self(), "mv-gateway", cfg.eRTPolicy, cfg.iGatewayPriority, cfg.iGatewayCPU);
+	SWakeupStats wakeup;
+	wakeup.Clear();
+	reportDeadline.Arm(600.0, 600.0);
+	CFrameRef frame;	// from the audio manager
+	CPacket message;	// from the GUI
+
+	// nothing happens here until a packet arrives or a deadline is due
 	while (keep_running)
 	{
-		if (ELinkState::linked == mlink.state)
-		{
-			LinkCheck();
-		}
-		else if (ELinkState::linking == mlink.state)
+		SIOEvent events[16];
+		const int count = engine->Wait(events, 16);
+		if (count < 0)
+			break;
+		for (int i=0; i<count && keep_running; i++)
 		{
-			if (linkingTime.time() >= 5.0)
+			const auto &ev = events[i];
+			switch (ev.tag)
 			{
-				SendLog("Link request to %s timeout.\n", mlink.cs.GetCS().c_str());
-				mlink.state = ELinkState::unlinked;
+			case evIPv4:
+			case evIPv6:
+			case evReflector:
+				if (ev.data)
+					ReadNetwork(ev);
+				break;
+			case evAudio:
+				AM2M17->Clear();
+				while (! AM2M17->Pop(frame))
+					ReadAudio(*frame);
+				frame.Reset();
+				break;
+			case evLink:
+				if (linkDeadline.IsArmed())
+				{
+					wakeup.Add(linkDeadline.Expired());
+					LinkTimeout();
+				}
+				break;
+			case evStream:
+				if (streamDeadline.IsArmed())
+				{
+					wakeup.Add(streamDeadline.Expired());
+					StreamTimeouts(CLatency::Now());
+				}
+				break;
+			case evReport:
+				reportDeadline.Expired();
+				std::cout << Now() << " Gateway wake-up latency: avg=" << wakeup.Average() << " max=" << wakeup.max << " us over " << wakeup.count << " timeouts" << std::endl;
+				wakeup.Clear();
+				break;
+			default:	// CIOEngine::WAKE_TAG, keep_running has changed or there's a message to send
+				while (! outbox.Pop(message))
+					Write(message.GetCData(), message.GetSize(), destination);
+				break;
 			}
 		}
+	}
+	CloseLink();
+	// the audio manager will close what's still open on its own
+	if (streams.Count())
+	{
+		streams.Clear();
+		streamDeadline.Disarm();
+		streamLock.unlock();
+	}
+	if (AM2M17->GetDropped() || M172AM->GetDropped())
+		std::cout << "Frames dropped because a channel was full: " << AM2M17->GetDropped() << " to the gateway, " << M172AM->GetDropped() << " from it" << std::endl;
+	ipv4.Close();
+	ipv6.Close();
+}
+
+void CM17Gateway::ReadNetwork(const SIOEvent &ev)
+{
+	const int64_t rxtime = ev.rxtime ? ev.rxtime : CLatency::Now();
+	const int length = ev.length;
+	if (length > MAX_PACKET_SIZE)
+	{
+		std::cerr << "Dropped a " << length << " byte packet" << std::endl;
+		return;
+	}
+	// the engine's buffer is good until the next Wait(), so only what's kept is copied
+	const unsigned char *data = ev.data;
+	memcpy(from17k.GetPointer(), ev.from, ev.fromlen);
 
-		if (currentStream.header.GetStreamId() && currentStream.lastPacketTime.time() >= 2.0)
+	switch (length)
+	{
+	case 4:  				// DISC, ACKN or NACK
+		if ((ELinkState::unlinked != mlink.state) && (from17k == mlink.addr))
 		{
-			StreamTimeout(); // current stream has timed out
+			if (0 == memcmp(data, "ACKN", 4))
+			{
+				mlink.state = ELinkState::linked;
+				SendLog("Connected to %s\n", mlink.cs.GetCS().c_str());
+				linkDeadline.Arm(PING_TIMEOUT);
+				// now the kernel doesn't have to look up the route for every packet to the reflector
+				if (linkSock.GetSocket() >= 0)
+					linkConnected = ! linkSock.Connect(mlink.addr);
+			}
+			else if (0 == memcmp(data, "NACK", 4))
+			{
+				mlink.state = ELinkState::unlinked;
+				SendLog("Link request refused from %s\n", mlink.cs.GetCS().c_str());
+				linkDeadline.Disarm();
+				CloseLink();
+			}
+			else if (0 == memcmp(data, "DISC", 4))
+			{
+				SendLog("Disconnected from %s\n", mlink.cs.GetCS().c_str());
+				mlink.state = ELinkState::unlinked;
+				linkDeadline.Disarm();
+				CloseLink();
+			}
+			else
+			{
+				Dump("unexpected packet while not unlinked", data, length);
+			}
 		}
-
-		FD_ZERO(&fdset);
-		if (EInternetType::ipv6only != cfg.eNetType)
-			FD_SET(ip4fd, &fdset);
-		if (EInternetType::ipv4only != cfg.eNetType)
-			FD_SET(ip6fd, &fdset);
-		FD_SET(amfd, &fdset);
-		tv.tv_sec = 0;
-		tv.tv_usec = 40000;	// wait up to 40 ms for something to happen
-		auto rval = select(max_nfds + 1, &fdset, 0, 0, &tv);
-		if (0 > rval)
+		else
 		{
-			std::cerr << "select() error: " << strerror(errno) << std::endl;
-			return;
+			Dump("unexpected packet while unlinked", data, length);
 		}
-
-		bool is_packet = false;
-		CPacket pack;
-		socklen_t fromlen = sizeof(struct sockaddr_storage);
-		int length;
-
-		if (keep_running && (ip4fd >= 0) && FD_ISSET(ip4fd, &fdset))
+		break;
+	case 10: 				// PING or DISC
+		if ((ELinkState::linked == mlink.state) && (from17k == mlink.addr))
 		{
-			length = recvfrom(ip4fd, pack.GetData(), MAX_PACKET_SIZE, 0, from17k.GetPointer(), &fromlen);
-			is_packet = true;
-			FD_CLR(ip4fd, &fdset);
+			if (0 == memcmp(data, "PING", 4))
+			{
+				Send(mlink.pongPacket.magic, 10, mlink.addr);
+				linkDeadline.Arm(PING_TIMEOUT);
+			}
+			else if (0 == memcmp(data, "DISC", 4))
+			{
+				mlink.state = ELinkState::unlinked;
+				linkDeadline.Disarm();
+				CloseLink();
+			}
+			else
+			{
+				Dump("unexpected packet", data, length);
+			}
 		}
-
-		if (keep_running && (ip6fd >= 0) && FD_ISSET(ip6fd, &fdset))
+		break;
+	default:	// An M17 frame
+		if (length > 37 && 0==memcmp(data, "M17P", 4))
 		{
-			length = recvfrom(ip6fd, pack.GetData(), MAX_PACKET_SIZE, 0, from17k.GetPointer(), &fromlen);
-			is_packet = true;
-			FD_CLR(ip6fd, &fdset);
+			memcpy(pmPacket.GetData(), data, length);
+			pmPacket.Initialize(length, false);
+			ProcessPacket(pmPacket);
 		}
-
-		if (keep_running && is_packet)
+		else if (STREAM_FRAME_SIZE==length && 0==memcmp(data, "M17 ", 4))
 		{
-			switch (length)
+			// it goes into a frame from the pool, and that's handed to the audio manager
+			auto frame = M172AM->NewFrame();
+			if (! frame)
 			{
-			case 4:  				// DISC, ACKN or NACK
-				if ((ELinkState::unlinked != mlink.state) && (from17k == mlink.addr))
-				{
-					if (0 == memcmp(pack.GetCData(), "ACKN", 4))
-					{
-						mlink.state = ELinkState::linked;
-						SendLog("Connected to %s\n", mlink.cs.GetCS().c_str());
-						mlink.receivePingTimer.start();
-					}
-					else if (0 == memcmp(pack.GetCData(), "NACK", 4))
-					{
-						mlink.state = ELinkState::unlinked;
-						SendLog("Link request refused from %s\n", mlink.cs.GetCS().c_str());
-						mlink.state = ELinkState::unlinked;
-					}
-					else if (0 == memcmp(pack.GetCData(), "DISC", 4))
-					{
-						SendLog("Disconnected from %s\n", mlink.cs.GetCS().c_str());
-						mlink.state = ELinkState::unlinked;
-					}
-					else
-					{
-						Dump("unexpected packet while not unlinked", pack.GetCData(), length);
-					}
-				}
-				else
-				{
-					Dump("unexpected packet while unlinked", pack.GetCData(), length);
-				}
-				break;
-			case 10: 				// PING or DISC
-				if ((ELinkState::linked == mlink.state) && (from17k == mlink.addr))
-				{
-					if (0 == memcmp(pack.GetCData(), "PING", 4))
-					{
-						Send(mlink.pongPacket.magic, 10, mlink.addr);
-						mlink.receivePingTimer.start();
-					}
-					else if (0 == memcmp(pack.GetCData(), "DISC", 4))
-					{
-						mlink.state = ELinkState::unlinked;
-					}
-					else
-					{
-						Dump("unexpected packet", pack.GetCData(), length);
-					}
-				}
-				break;
-			default:	// An M17 frame
-				if (length > 37 && 0==memcmp(pack.GetCData(), "M17P", 4))
-				{
-					pack.Initialize(length, false);
-					ProcessPacket(pack);
-				}
-				else if (54u==length && 0==memcmp(pack.GetCData(), "M17 ", 4))
-				{
-					pack.Initialize(length, true);
-					ProcessFrame(pack);
-				}
-				else
-					Dump("unknown packet", pack.GetCData(), length);
+				std::cerr << "The frame pool is empty, dropped a stream frame" << std::endl;
 				break;
 			}
+			memcpy(frame->GetData(), data, length);
+			frame->Initialize(length, true);
+			frame->SetRXTime(rxtime);	// it goes with the frame, so the audio manager can time it
+			ProcessFrame(std::move(frame), rxtime);
 		}
+		else
+			Dump("unknown packet", data, length);
+		break;
+	}
+}
 
-		if (keep_running && FD_ISSET(amfd, &fdset))
+void CM17Gateway::ReadAudio(const CStreamFrame &pack)
+{
+	const auto length = pack.GetSize();
+	// voice frames were stamped by the audio manager, link commands weren't
+	const auto readtime = CLatency::Now();
+	int64_t origin, stamp;
+	const bool timed = CLatency::FindTX(pack.GetFrameNumber(), origin, stamp) && readtime - stamp < 1000000000;
+	if (timed)
+		CLatency::Record(ELatencyStage::txIPC, readtime - stamp);
+	const CCallsign dest(pack.GetCDstAddress());
+	//printf("DEST=%s=0x%02x%02x%02x%02x%02x%02x\n", dest.GetCS().c_str(), pack.GetCDstAddress()[0], pack.GetCDstAddress()[1], pack.GetCDstAddress()[2], pack.GetCDstAddress()[3], pack.GetCDstAddress()[4], pack.GetCDstAddress()[5]);
+	//std::cout << "Read " << length << " bytes with dest='" << dest.GetCS() << "'" << std::endl;
+	if (0==dest.GetCS(3).compare("M17") || 0==dest.GetCS(3).compare("URF")) // Linking a reflector
+	{
+		switch (mlink.state)
 		{
-			CPacket pack;
-			pack.Initialize(54, true);
-			length = AM2M17.Read(pack.GetData(), pack.GetSize());
-			const CCallsign dest(pack.GetCDstAddress());
-			//printf("DEST=%s=0x%02x%02x%02x%02x%02x%02x\n", dest.GetCS().c_str(), pack.GetCDstAddress()[0], pack.GetCDstAddress()[1], pack.GetCDstAddress()[2], pack.GetCDstAddress()[3], pack.GetCDstAddress()[4], pack.GetCDstAddress()[5]);
-			//std::cout << "Read " << length << " bytes with dest='" << dest.GetCS() << "'" << std::endl;
-			if (0==dest.GetCS(3).compare("M17") || 0==dest.GetCS(3).compare("URF")) // Linking a reflector
+		case ELinkState::linked:
+			if (mlink.cs == dest) // this is heading in to the correct desination
 			{
-				switch (mlink.state)
-				{
-				case ELinkState::linked:
-					if (mlink.cs == dest) // this is heading in to the correct desination
-					{
-						Write(pack.GetCData(), length, mlink.addr);
-					}
-					break;
-				case ELinkState::unlinked:
-					if ('L' == dest.GetCS().at(7))
-					{
-						std::string ref(dest.GetCS(7));
-						ref.resize(8, ' ');
-						ref.resize(9, dest.GetModule());
-						const CCallsign d(ref);
-						SendLinkRequest(d);
-					}
-					break;
-				default:
-					break;
-				}
+				Write(pack.GetCData(), length, mlink.addr);
 			}
-			else if (0 == dest.GetCS().compare("U"))
+			break;
+		case ELinkState::unlinked:
+			if ('L' == dest.GetCS().at(7))
 			{
-				SM17RefPacket disc;
-				memcpy(disc.magic, "DISC", 4);
-				std::string s(cfg.sM17SourceCallsign);
-				s.resize(8, ' ');
-				s.append(1, cfg.cModule);
-				CCallsign call(s);
-				call.CodeOut(disc.cscode);
-				Write(disc.magic, 10, mlink.addr);
-			} else {
-				Write(pack.GetCData(), length, destination);
+				std::string ref(dest.GetCS(7));
+				ref.resize(8, ' ');
+				ref.resize(9, dest.GetModule());
+				const CCallsign d(ref);
+				SendLinkRequest(d);
 			}
-			FD_CLR(amfd, &fdset);
+			break;
+		default:
+			break;
 		}
 	}
-	AM2M17.Close();
-	ipv4.Close();
-	ipv6.Close();
+	else if (0 == dest.GetCS().compare("U"))
+	{
+		SM17RefPacket disc;
+		memcpy(disc.magic, "DISC", 4);
+		std::string s(cfg.sM17SourceCallsign);
+		s.resize(8, ' ');
+		s.append(1, cfg.cModule);
+		CCallsign call(s);
+		call.CodeOut(disc.cscode);
+		Write(disc.magic, 10, mlink.addr);
+	} else {
+		Write(pack.GetCData(), length, destination);
+	}
+	if (timed)
+	{
+		const auto now = CLatency::Now();
+		CLatency::Record(ELatencyStage::txSend, now - readtime);
+		CLatency::Record(ELatencyStage::txTotal, now - origin);
+	}
 }
 
 void CM17Gateway::SetDestAddress(const std::string &address, uint16_t port)
@@ -324,6 +451,7 @@ void CM17Gateway::SendLinkRequest(const CCallsign &ref)
 	mlink.addr = destination;
 	mlink.cs = ref;
 	mlink.from_mod = cfg.cModule;
+	OpenLink();
 
 	// make a CONN packet
 	SM17RefPacket conn;
@@ -341,7 +469,7 @@ void CM17Gateway::SendLinkRequest(const CCallsign &ref)
 
 	// finish up
 	mlink.state = ELinkState::linking;
-	linkingTime.start();
+	linkDeadline.Arm(LINK_TIMEOUT);
 }
 
 bool CM17Gateway::ProcessPacket(const CPacket &pack)
@@ -395,67 +523,74 @@ bool CM17Gateway::ProcessPacket(const CPacket &pack)
 	return true;
 }
 
-bool CM17Gateway::ProcessFrame(const CPacket &pack)
+// the frame is pushed last, once the audio manager has it, it's not ours to read
+bool CM17Gateway::ProcessFrame(CFrameRef &&frame, int64_t now)
 {
-	if (currentStream.header.GetStreamId())
+	const auto &pack = *frame;
+	const auto due = now + int64_t(STREAM_TIMEOUT * 1.0e9);
+	auto stream = streams.Find(pack.GetStreamId(), from17k);
+	if (stream)
 	{
-		if (currentStream.header.GetStreamId() == pack.GetStreamId())
-		{
-			M172AM.Write(pack.GetCData(), pack.GetSize());
-			currentStream.header.SetFrameNumber(pack.GetFrameNumber());
-			uint16_t fn = pack.GetFrameNumber();
-			if (fn & 0x8000u)
-			{
-				SendLog("Close stream id=0x%04x, duration=%.2f sec\n", pack.GetStreamId(), 0.04f * (0x7fffu & fn));
-				currentStream.header.SetFrameNumber(0); // close the stream
-				currentStream.header.SetStreamId(0u);
-				streamLock.unlock();
-			}
-			else
-			{
-				currentStream.lastPacketTime.start();
-			}
-		}
-		else
-		{
-			return false;
-		}
+		frame->SetStreamKey(stream->key);
+		if (CStreamTable::Update(*stream, pack, due))
+			CloseStream(stream);
 	}
 	else
 	{
-		// here comes a first packet, so try to lock it
-		if (streamLock.try_lock())
-		{
-			// then init the currentStream
-			auto check = crc.CalcCRC(pack.GetCData(), 52u);
-			if (pack.GetCRC() != check)
-				std::cout << Now() << "Header Packet crc=0x" << std::hex << pack.GetCRC() << " calculate=0x" << std::hex << check << std::endl;
-			memcpy(currentStream.header.GetData(), pack.GetCData(), 54u);
-			M172AM.Write(pack.GetCData(), 54u);
-			const CCallsign src(pack.GetCSrcAddress());
-			SendLog("Open stream id=0x%04x from %s at %s\n", pack.GetStreamId(), src.GetCS().c_str(), from17k.GetAddress());
-			currentStream.lastPacketTime.start();
-		}
-		else
+		if (pack.GetFrameNumber() & 0x8000u)
+			return false;	// the end of a stream that's already closed
+		// the first stream keeps us from transmitting until the last one is done
+		if (0u == streams.Count() && ! streamLock.try_lock())
+			return false;
+		stream = streams.Insert(pack, from17k, now, due);
+		if (nullptr == stream)
 		{
+			if (0u == streams.Count())
+				streamLock.unlock();
+			std::cerr << "Too many streams, dropped a frame from stream 0x" << std::hex << pack.GetStreamId() << std::dec << std::endl;
 			return false;
 		}
+		frame->SetStreamKey(stream->key);
+		auto check = crc.CalcCRC(pack.GetCData(), 52u);
+		if (pack.GetCRC() != check)
+			std::cout << Now() << "Header Packet crc=0x" << std::hex << pack.GetCRC() << " calculate=0x" << std::hex << check << std::endl;
+		const CCallsign src(pack.GetCSrcAddress());
+		SendLog("Open stream id=0x%04x from %s at %s\n", pack.GetStreamId(), src.GetCS().c_str(), from17k.GetAddress());
+		if (! streamDeadline.IsArmed())
+			streamDeadline.Arm(STREAM_TIMEOUT);
 	}
+	M172AM->Push(0u, std::move(frame));
+	return true;
+}
+
+// returns true if it went to the reflector on its own socket
+bool CM17Gateway::WriteLink(const void *buf, size_t size, const CSockAddress &addr) const
+{
+	if (linkSock.GetSocket() < 0 || addr != mlink.addr || addr.GetPort() != mlink.addr.GetPort())
+		return false;
+	if (linkConnected)
+		engine->Send(linkSock.GetSocket(), buf, size, nullptr, 0);
+	else
+		engine->Send(linkSock.GetSocket(), buf, size, addr.GetCPointer(), addr.GetSize());
 	return true;
 }
 
 void CM17Gateway::Write(const void *buf, const size_t size, const CSockAddress &addr) const
 {
+	if (WriteLink(buf, size, addr))
+		return;
 	if (AF_INET6 == addr.GetFamily())
-		ipv6.Write(buf, size, addr);
+		engine->Send(ipv6.GetSocket(), buf, size, addr.GetCPointer(), addr.GetSize());
 	else
-		ipv4.Write(buf, size, addr);
+		engine->Send(ipv4.GetSocket(), buf, size, addr.GetCPointer(), addr.GetSize());
 }
 
 void CM17Gateway::Send(const void *buf, size_t size, const CSockAddress &addr) const
 {
+	if (WriteLink(buf, size, addr))
+		return;
 	if (AF_INET ==  addr.GetFamily())
-		ipv4.Write(buf, size, addr);
+		engine->Send(ipv4.GetSocket(), buf, size, addr.GetCPointer(), addr.GetSize());
 	else
-		ipv6.Write(buf, size, addr);
+		engine->Send(ipv6.GetSocket(), buf, size, addr.GetCPointer(), addr.GetSize());
 }
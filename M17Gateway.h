@@ -27,7 +27,9 @@
 #include "Configure.h"
 #include "UDPSocket.h"
 #include "Callsign.h"
-#include "Timer.h"
+#include "IOEngine.h"
+#include "StreamTable.h"
+#include "FrameChannel.h"
 #include "Packet.h"
 #include "Base.h"
 #include "CRC.h"
@@ -41,13 +43,6 @@ using SM17Link = struct sm17link_tag
 	CCallsign cs;
 	char from_mod;
 	std::atomic<ELinkState> state;
-	CTimer receivePingTimer;
-};
-
-using SStream = struct stream_tag
-{
-	CTimer lastPacketTime;
-	CPacket header;
 };
 
 class CM17Gateway : public CBase
@@ -55,12 +50,17 @@ class CM17Gateway : public CBase
 public:
 	CM17Gateway();
 	~CM17Gateway();
-	bool Init(const CFGDATA &cfgdata);
+	// the channels are to and from the audio manager
+	bool Init(const CFGDATA &cfgdata, CFrameChannel *am2m17, CFrameChannel *m172am);
 	void Process();
+	// from another thread, makes Process() return
+	void Stop();
 	void SetDestAddress(const std::string &address, uint16_t port);
 	ELinkState GetLinkState() const { return mlink.state; }
+	// for our own transmissions, it fails while any stream is being received
 	bool TryLock();
 	void ReleaseLock();
+	// from any thread, it's sent on the gateway thread
 	void SendMessage(const CPacket &p);
 
 	std::atomic<bool> keep_running;
@@ -68,21 +68,32 @@ public:
 private:
 	CFGDATA cfg;
 	CCRC crc;
-	CUnixDgramReader AM2M17;
-	CUnixDgramWriter M172AM;
+	CFrameChannel *AM2M17, *M172AM;
 	CUDPSocket ipv4, ipv6;
+	CUDPSocket linkSock;	// the reflector gets a socket of its own
+	bool linkConnected;
 	SM17Link mlink;
-	CTimer linkingTime;
-	SStream currentStream;
-	std::mutex streamLock;
+	CStreamTable streams;	// what's being received, each one goes to the audio manager on its own
+	CPacket pmPacket;	// packet mode packets are put together here
+	CTBoundedQueue<CPacket, 8> outbox;	// SMS messages from the GUI, waiting for the gateway thread
+	std::unique_ptr<CIOEngine> engine;
+	CDeadline linkDeadline, streamDeadline, reportDeadline;
+	std::mutex streamLock;	// held by the gateway while streams are open, or by whoever is transmitting
 	std::string qnvoice_file;
 	CSockAddress from17k, destination;
 
-	void LinkCheck();
+	void ReadNetwork(const SIOEvent &ev);
+	void ReadAudio(const CStreamFrame &pack);
+	void LinkTimeout();
+	void OpenLink();
+	void CloseLink();
+	bool WriteLink(const void *buf, size_t size, const CSockAddress &addr) const;
 	void Write(const void *buf, const size_t size, const CSockAddress &addr) const;
-	void StreamTimeout();
+	void StreamTimeouts(int64_t now);
+	void StreamTimeout(const SStream &stream);
+	void CloseStream(SStream *stream);
 	void Send(const void *buf, size_t size, const CSockAddress &addr) const;
-	bool ProcessFrame(const CPacket &pack);
+	bool ProcessFrame(CFrameRef &&frame, int64_t now);
 	bool ProcessPacket(const CPacket &pack);
 	void SendLinkRequest(const CCallsign &ref);
 };
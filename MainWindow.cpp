@@ -23,6 +23,8 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 
 #include <iostream>
 #include <sstream>
@@ -60,6 +62,13 @@ static void MyIdleProcess(void *p)
 	Fl::repeat_timeout(1.0, MyIdleProcess, pMainWindow);
 }
 
+static void MeterProcess(void *p)
+{
+	((CMainWindow *)p)->UpdateMeter();
+
+	Fl::repeat_timeout(0.05, MeterProcess, p);
+}
+
 CMainWindow::CMainWindow() :
 #ifndef NO_DHT
 	exportNodeFilename("/exNodes.bin"),
@@ -69,7 +78,12 @@ CMainWindow::CMainWindow() :
 	bTargetIP(false),
 	bTargetPort(false),
 	bDestCS(false),
-	bTransOK(true)
+	bTransOK(true),
+	txFrames(0u),
+	rxFrames(0u),
+	bFileTX(false),
+	bTuning(false),
+	bReplaying(false)
 {
 	cfg.CopyTo(cfgdata);
 	// allowed M17 " ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-/."
@@ -114,10 +128,24 @@ CMainWindow::~CMainWindow()
 		delete pWin;
 }
 
+static void LockMemory()
+{
+	// MCL_FUTURE is only safe when there's no limit on locked memory,
+	// otherwise later allocations could fail
+	int flags = MCL_CURRENT;
+	struct rlimit rl;
+	if (0 == getrlimit(RLIMIT_MEMLOCK, &rl) && RLIM_INFINITY == rl.rlim_cur)
+		flags |= MCL_FUTURE;
+	if (mlockall(flags))
+		std::cerr << "Could not lock memory: " << strerror(errno) << ", continuing without it" << std::endl;
+	else
+		std::cout << "Memory is locked" << ((flags & MCL_FUTURE) ? "" : ", but only the current pages") << std::endl;
+}
+
 void CMainWindow::RunM17()
 {
 	std::cout << "Starting M17 Gateway..." << std::endl;
-	if (! gateM17.Init(cfgdata))
+	if (! gateM17.Init(cfgdata, &AM2M17, &M172AM))
 		gateM17.Process();
 	std::cout << "M17 Gateway has stopped." << std::endl;
 }
@@ -214,16 +242,20 @@ void CMainWindow::SetState()
 
 void CMainWindow::CloseAll()
 {
+	AM2M17.Close();
 	M172AM.Close();
 	LogInput.Close();
 }
 
 bool CMainWindow::Init()
 {
+	if (cfgdata.bLockMemory)
+		LockMemory();
+
 	keep_running = true;
 	futReadThread = std::async(std::launch::async, &CMainWindow::ReadThread, this);
 
-	if (M172AM.Open("m172am")) {
+	if (AM2M17.Open(CAudioManager::GATEWAY_LANES, &framePool) || M172AM.Open(1u, &framePool)) {
 		CloseAll();
 		return true;
 	}
@@ -251,6 +283,10 @@ bool CMainWindow::Init()
 	pMenuBar->labelsize(16);
 	pMenuBar->add(_("Target"), 0, 0, 0, FL_SUBMENU);
 	pMenuBar->add(_("Texting..."), 0, &CMainWindow::ShowSMSDialogCB, this, 0);
+	pMenuBar->add(_("Transmit File..."), 0, &CMainWindow::TransmitFileCB, this, 0);
+	pMenuBar->add(_("Replay Echo"), 0, &CMainWindow::ReplayEchoCB, this, 0);
+	pMenuBar->add(_("Replay Last Heard"), 0, &CMainWindow::ReplayLastCB, this, 0);
+	pMenuBar->add(_("Replay All Heard"), 0, &CMainWindow::ReplayAllCB, this, 0);
 	pMenuBar->add(_("Settings..."), 0, &CMainWindow::ShowSettingsDialogCB, this, 0);
 	pMenuBar->add(_("About..."),    0, &CMainWindow::ShowAboutDialogCB,    this, 0);
 
@@ -362,6 +398,9 @@ bool CMainWindow::Init()
 	pQuickKeyButton->deactivate();
 	pQuickKeyButton->callback(QuickKeyButttonCB, this);
 
+	pVUMeter = new CVUMeter(250, 584, 400, 12);
+	pVUMeter->tooltip(_("The audio level you are sending or hearing"));
+
 	pWin->end();
 
 	if (SMSDlg.Init(this))
@@ -388,6 +427,7 @@ bool CMainWindow::Init()
 
 	// idle processing
 	Fl::add_timeout(1.0, MyIdleProcess, this);
+	Fl::add_timeout(0.05, MeterProcess, this);
 
 #ifndef NO_DHT
 	// start the dht instance
@@ -452,7 +492,31 @@ void CMainWindow::ActivateModules(const std::string &modules)
 
 void CMainWindow::Run(int argc, char *argv[])
 {
-	pWin->show(argc, argv);
+	// take out our options, FLTK gets the rest
+	std::string in, out;
+	bool nopace = false, loop = false;
+	int n = 1;
+	for (int i=1; i<argc; i++)
+	{
+		if (0 == strcmp(argv[i], "--audio-in") && i+1 < argc)
+			in.assign(argv[++i]);
+		else if (0 == strcmp(argv[i], "--audio-out") && i+1 < argc)
+			out.assign(argv[++i]);
+		else if (0 == strcmp(argv[i], "--no-pace"))
+			nopace = true;
+		else if (0 == strcmp(argv[i], "--loop"))
+			loop = true;
+		else
+			argv[n++] = argv[i];
+	}
+	argv[n] = nullptr;
+	// a bare path is a file device
+	if (in.size() && in.npos != in.find('/') && ! CAudioDevice::IsFile(in))
+		in.insert(0, "file:");
+	if (out.size() && out.npos != out.find('/') && ! CAudioDevice::IsFile(out))
+		out.insert(0, "file:");
+	AudioManager.SetAudioDevices(in, out, nopace, loop);
+	pWin->show(n, argv);
 }
 
 void CMainWindow::QuitCB(Fl_Widget *, void *This)
@@ -588,14 +652,14 @@ void CMainWindow::ActionButton()
 	routeMap.Save();
 }
 
-void CMainWindow::AudioSummary(const char *title)
+void CMainWindow::AudioSummary(const char *title, const SLevels &levels)
 {
 		char line[64];
-		double t = AudioManager.volStats.count * 0.000125;	// 0.000125 = 1 / 8000
+		double t = levels.count * 0.000125;	// 0.000125 = 1 / 8000
 		// we only do the sums of squares on every other point, so 0.5 mult in denominator
 		// 65 db subtration for "reasonable volume", an arbitrary reference point
-		double d = 20.0 * log10(sqrt(AudioManager.volStats.ss/(0.5 * AudioManager.volStats.count))) - 65.0;
-		double c = 100.0 * AudioManager.volStats.clip / AudioManager.volStats.count;
+		double d = 20.0 * log10(sqrt(levels.ss/(0.5 * levels.count))) - 65.0;
+		double c = 100.0 * levels.clip / levels.count;
 		snprintf(line, 64, _("%s Time=%.1fs Vol=%.0fdB Clip=%.0f%%\n"), title, t, d, c);
 		std::lock_guard<std::mutex> lck(logmux);
 		insertLogText(line);
@@ -608,32 +672,135 @@ void CMainWindow::EchoButtonCB(Fl_Widget *, void *This)
 
 void CMainWindow::EchoButton()
 {
+	if (bReplaying) {
+		// it was a long replay, EchoDone() is called when it stops
+		pEchoTestButton->value(0);
+		pEchoTestButton->deactivate();
+		AudioManager.StopReplay();
+		return;
+	}
 	pEchoTestButton->toggle();
 	auto onchar = pEchoTestButton->value();
 	if (onchar) {
 		bTransOK = false;
 		// record the mic to a queue
-		AudioManager.RecordMicThread(E_PTT_Type::echo, "ECHOTEST");
+		if (AudioManager.RecordMicThread(E_PTT_Type::echo, "ECHOTEST")) {
+			pEchoTestButton->value(0);
+			bTransOK = true;
+		}
 	} else {
-		AudioSummary(_("Echo"));
-		// play back the queue
-		AudioManager.PlayEchoDataThread();
-		bTransOK = true;
+		AudioSummary(_("Echo"), AudioManager.txMeter.Read());
+		// play back the recording, EchoDone() is called when it's finished
+		pEchoTestButton->deactivate();
+		AudioManager.PlayEcho(false, [this]{ Fl::awake(&CMainWindow::EchoDoneCB, this); });
+	}
+}
+
+void CMainWindow::ReplayEchoCB(Fl_Widget *, void *This)
+{
+	((CMainWindow *)This)->ReplayEcho();
+}
+
+void CMainWindow::ReplayEcho()
+{
+	if (! bTransOK || 0 == pEchoTestButton->active() || ! AudioManager.HasEcho())
+	{
+		std::lock_guard<std::mutex> lck(logmux);
+		insertLogText(_("There's no echo test to replay right now.\n"));
+		return;
+	}
+	bTransOK = false;
+	pEchoTestButton->deactivate();
+	TransmitterButtonControl();
+	AudioManager.PlayEcho(true, [this]{ Fl::awake(&CMainWindow::EchoDoneCB, this); });
+}
+
+void CMainWindow::ReplayLastCB(Fl_Widget *, void *This)
+{
+	((CMainWindow *)This)->ReplayHeard(false);
+}
+
+void CMainWindow::ReplayAllCB(Fl_Widget *, void *This)
+{
+	((CMainWindow *)This)->ReplayHeard(true);
+}
+
+void CMainWindow::ReplayHeard(bool all)
+{
+	if (! bTransOK || 0 == pEchoTestButton->active() || ! AudioManager.HasReplay())
+	{
+		std::lock_guard<std::mutex> lck(logmux);
+		insertLogText(_("There's nothing to replay right now.\n"));
+		return;
+	}
+	// it's played just like an echo test, but the echo button stays on to stop it
+	bTransOK = false;
+	bReplaying = true;
+	TransmitterButtonControl();
+	AudioManager.PlayReplay(all, [this]{ Fl::awake(&CMainWindow::EchoDoneCB, this); });
+}
+
+void CMainWindow::EchoDoneCB(void *This)
+{
+	((CMainWindow *)This)->EchoDone();
+}
+
+// on the GUI thread, after the echo test has been played
+void CMainWindow::EchoDone()
+{
+	bReplaying = false;
+	// a stream that started in the meantime has the controls, Receive(false) gives them back
+	if (AudioManager.IsReceiving()) {
+		pEchoTestButton->deactivate();
+		return;
 	}
+	bTransOK = true;
+	if (! bTuning)
+		pEchoTestButton->activate();
+	TransmitterButtonControl();
 }
 
 void CMainWindow::Receive(bool is_rx)
 {
-	bTransOK = ! is_rx;
+	// a replay keeps the controls until it's done, and its echo button stays on to stop it
+	bTransOK = ! is_rx && ! bReplaying;
 	TransmitterButtonControl();
 
-	if (bTransOK)
+	if ((bTransOK || bReplaying) && ! bTuning)
 		pEchoTestButton->activate();
 	else
 		pEchoTestButton->deactivate();
 
-	if (bTransOK && AudioManager.volStats.count)
-		AudioSummary(_("RX Audio"));
+	const auto levels = AudioManager.rxMeter.Read();
+	if (bTransOK && levels.count)
+		AudioSummary(_("RX Audio"), levels);
+}
+
+// on the GUI thread, when the settings dialog starts and finishes tuning
+void CMainWindow::SetTuning(bool is_tuning)
+{
+	bTuning = is_tuning;
+	TransmitterButtonControl();
+	if (bTransOK && ! bTuning)
+		pEchoTestButton->activate();
+	else
+		pEchoTestButton->deactivate();
+}
+
+// on the GUI thread, about 20 times a second
+void CMainWindow::UpdateMeter()
+{
+	// show whichever side has audio flowing, TX first
+	const auto tx = AudioManager.txMeter.Read();
+	const auto rx = AudioManager.rxMeter.Read();
+	if (tx.frames != txFrames)
+		pVUMeter->Set(tx.rms, tx.peak);
+	else if (rx.frames != rxFrames)
+		pVUMeter->Set(rx.rms, rx.peak);
+	else
+		pVUMeter->Idle();
+	txFrames = tx.frames;
+	rxFrames = rx.frames;
 }
 
 void CMainWindow::SetTargetAddress(std::string &cs)
@@ -665,7 +832,11 @@ void CMainWindow::PTTButton()
 		if (gateM17.TryLock())
 		{
 			const std::string cs(pDSTCallsignInput->value());
-			AudioManager.RecordMicThread(E_PTT_Type::m17, cs);
+			if (AudioManager.RecordMicThread(E_PTT_Type::m17, cs))
+			{
+				pPTTButton->value(0);
+				gateM17.ReleaseLock();
+			}
 		}
 		else
 		{
@@ -674,16 +845,72 @@ void CMainWindow::PTTButton()
 	}
 	else
 	{
+		bFileTX = false;
 		AudioManager.KeyOff();
-		AudioSummary(pttstr);
+		const auto levels = AudioManager.txMeter.Read();
+		if (levels.count)
+			AudioSummary(pttstr, levels);
 		gateM17.ReleaseLock();
 	}
 }
 
+void CMainWindow::TransmitFileCB(Fl_Widget *, void *This)
+{
+	((CMainWindow *)This)->TransmitFile();
+}
+
+void CMainWindow::TransmitFile()
+{
+	if (0 == pPTTButton->active() || pPTTButton->value())
+	{
+		std::lock_guard<std::mutex> lck(logmux);
+		insertLogText(_("You can't transmit a file right now.\n"));
+		return;
+	}
+	const char *path = fl_file_chooser(_("Transmit File"), _("Audio Files (*.{wav,raw,c2})"), nullptr);
+	if (nullptr == path)
+		return;
+	if (gateM17.TryLock())
+	{
+		const std::string cs(pDSTCallsignInput->value());
+		// the PTT button stays down while the file is sent, and it can be used to stop early
+		pPTTButton->value(1);
+		bFileTX = true;
+		if (AudioManager.TransmitFile(path, cs, [this]{ Fl::awake(&CMainWindow::TransmitFileDoneCB, this); }))
+		{
+			bFileTX = false;
+			pPTTButton->value(0);
+			gateM17.ReleaseLock();
+		}
+	}
+}
+
+void CMainWindow::TransmitFileDoneCB(void *This)
+{
+	((CMainWindow *)This)->TransmitFileDone();
+}
+
+// on the GUI thread, after the whole file was sent
+void CMainWindow::TransmitFileDone()
+{
+	if (! bFileTX)
+		return;	// the PTT button already stopped it
+	bFileTX = false;
+	pPTTButton->value(0);
+	const auto levels = AudioManager.txMeter.Read();
+	if (levels.count)
+		AudioSummary(pttstr, levels);
+	gateM17.ReleaseLock();
+}
+
 void CMainWindow::QuickKeyButton()
 {
 	std::string cs(pDSTCallsignInput->value());
-	AudioManager.QuickKey(cs, cfgdata.sM17SourceCallsign);
+	if (pPTTButton->value() || AudioManager.QuickKey(cs, cfgdata.sM17SourceCallsign))
+	{
+		std::lock_guard<std::mutex> lck(logmux);
+		insertLogText(_("You can't Quick Key while you're transmitting.\n"));
+	}
 }
 
 void CMainWindow::QuickKeyButttonCB(Fl_Widget *, void *This)
@@ -717,12 +944,12 @@ void CMainWindow::ReadThread()
 		{
 			if (FD_ISSET(gatefd, &fdset))
 			{
-				CPacket pack;
-				M172AM.Read(pack.GetData(), MAX_PACKET_SIZE);
-				if (0 == memcmp(pack.GetCData(), "M17 ", 4))
+				M172AM.Clear();
+				CFrameRef frame;
+				while (! M172AM.Pop(frame))
 				{
-					pack.Initialize(54u, true);
-					AudioManager.M17_2AudioMgr(pack);
+					if (frame->IsStreamData())
+						AudioManager.M17_2AudioMgr(frame);
 				}
 			}
 			if (FD_ISSET(logfd, &fdset))
@@ -1217,7 +1444,7 @@ void CMainWindow::FixTargetMenuButton()
 void CMainWindow::TransmitterButtonControl()
 {
 	DestinationCSInput();
-	if (bTransOK && bDestCS && bTargetCS && bTargetIP && bTargetPort && (0 == pConnectButton->active()))
+	if (bTransOK && ! bTuning && bDestCS && bTargetCS && bTargetIP && bTargetPort && (0 == pConnectButton->active()))
 	{
 		pPTTButton->activate();
 		pQuickKeyButton->activate();
@@ -1234,7 +1461,7 @@ void CMainWindow::TransmitterButtonControl()
 void CMainWindow::StopM17()
 {
 	if (gateM17.keep_running) {
-		gateM17.keep_running = false;
+		gateM17.Stop();
 		futM17.get();
 	}
 }
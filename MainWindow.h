@@ -35,6 +35,7 @@
 #include "AboutDlg.h"
 #include "AudioManager.h"
 #include "TransmitButton.h"
+#include "VUMeter.h"
 
 class CMainWindow
 {
@@ -42,14 +43,21 @@ public:
 	CMainWindow();
 	~CMainWindow();
 
+	// every stream frame in flight comes from here, so it goes before anything that can hold one
+	CFramePool framePool;
 	CConfigure cfg;
 	CAudioManager AudioManager;
+	// the frames between the audio manager and the gateway
+	CFrameChannel AM2M17, M172AM;
 
 	bool Init();
 	void Run(int argc, char *argv[]);
 	void Receive(bool is_rx);
+	// the transmit, echo and replay controls are off while the sound card is tuned
+	void SetTuning(bool is_tuning);
 	void NewSettings(CFGDATA *newdata);
 	void UpdateGUI();
+	void UpdateMeter();
 	bool SendMessage(const std::string &dst, const std::string &message);
 
 	// helpers
@@ -75,6 +83,7 @@ private:
 	// widgets
 	Fl_Double_Window *pWin;
 	CTransmitButton *pPTTButton, *pEchoTestButton;
+	CVUMeter *pVUMeter;
 	Fl_Button *pQuickKeyButton, *pActionButton, *pConnectButton, *pDisconnectButton, *pDashboardButton;
 	Fl_Check_Button *pIsLegacyCheck;
 	Fl_Input *pTargetCSInput, *pTargetIpInput;
@@ -102,10 +111,10 @@ private:
 	void RunM17();
 	void StopM17();
 	void ReadThread();
-	CUnixDgramReader M172AM, LogInput;
+	CUnixDgramReader LogInput;
 	void CloseAll();
 	void insertLogText(const char *line);
-	void AudioSummary(const char *title);
+	void AudioSummary(const char *title, const SLevels &levels);
 	char GetTargetModule();
 	void SetTargetAddress(std::string &cs);
 #ifndef NO_DHT
@@ -119,8 +128,13 @@ private:
 	void ShowSettingsDialog();
 	void ShowAboutDialog();
 	void EchoButton();
+	void ReplayEcho();
+	void ReplayHeard(bool all);
+	void EchoDone();
 	void PTTButton();
 	void QuickKeyButton();
+	void TransmitFile();
+	void TransmitFileDone();
 	void TargetCSInput();
 	void TargetIPInput();
 	void DestinationCSInput();
@@ -136,8 +150,14 @@ private:
 	static void ShowSettingsDialogCB(Fl_Widget *p, void *v);
 	static void ShowAboutDialogCB(Fl_Widget *p, void *v);
 	static void EchoButtonCB(Fl_Widget *p, void *v);
+	static void ReplayEchoCB(Fl_Widget *p, void *v);
+	static void ReplayLastCB(Fl_Widget *p, void *v);
+	static void ReplayAllCB(Fl_Widget *p, void *v);
+	static void EchoDoneCB(void *v);
 	static void PTTButtonCB(Fl_Widget *p, void *v);
 	static void QuickKeyButttonCB(Fl_Widget *, void *);
+	static void TransmitFileCB(Fl_Widget *p, void *v);
+	static void TransmitFileDoneCB(void *v);
 	static void TargetCSInputCB(Fl_Widget *p, void *v);
 	static void TargetIPInputCB(Fl_Widget *p, void *v);
 	static void TargetPortInputCB(Fl_Widget *p, void *v);
@@ -149,5 +169,9 @@ private:
 	static void DashboardButtonCB(Fl_Widget *p, void *v);
 
 	bool bDestCS, bTargetCS, bTargetIP, bTargetPort, bTransOK;
+	uint32_t txFrames, rxFrames;	// what the VU meter saw last time
+	bool bFileTX;	// the PTT button is down because a file is being sent
+	bool bTuning;	// the settings dialog is tuning the sound card
+	bool bReplaying;	// heard audio is being replayed, the echo button stops it
 	std::atomic<bool> keep_running;
 };
@@ -0,0 +1,252 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "Mixer.h"
+
+// acc[i] += gain * in[i], for 160 samples
+static void Accumulate(float *acc, const short *in, float gain)
+{
+#if defined(__SSE2__)
+	const __m128 g = _mm_set1_ps(gain);
+	for (unsigned int i=0; i<160; i+=8) {
+		const __m128i s = _mm_loadu_si128((const __m128i *)(in + i));
+		// sign extend the 16-bit samples to 32 bits
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+		_mm_storeu_ps(acc + i,     _mm_add_ps(_mm_loadu_ps(acc + i),     _mm_mul_ps(_mm_cvtepi32_ps(lo), g)));
+		_mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(_mm_cvtepi32_ps(hi), g)));
+	}
+#elif defined(__ARM_NEON)
+	for (unsigned int i=0; i<160; i+=8) {
+		const int16x8_t s = vld1q_s16(in + i);
+		const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+		const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+		vst1q_f32(acc + i,     vmlaq_n_f32(vld1q_f32(acc + i),     lo, gain));
+		vst1q_f32(acc + i + 4, vmlaq_n_f32(vld1q_f32(acc + i + 4), hi, gain));
+	}
+#else
+	for (unsigned int i=0; i<160; i++)
+		acc[i] += gain * in[i];
+#endif
+}
+
+// rounds and saturates the sum to 16 bits, returns how many samples were saturated
+static unsigned int Saturate(const float *acc, short *out)
+{
+	unsigned int clipped = 0u;
+#if defined(__SSE2__)
+	const __m128 top = _mm_set1_ps(32767.0f), bottom = _mm_set1_ps(-32768.0f);
+	for (unsigned int i=0; i<160; i+=8) {
+		const __m128 a = _mm_loadu_ps(acc + i), b = _mm_loadu_ps(acc + i + 4);
+		clipped += __builtin_popcount(_mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(a, top), _mm_cmplt_ps(a, bottom))));
+		clipped += __builtin_popcount(_mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(b, top), _mm_cmplt_ps(b, bottom))));
+		// _mm_packs_epi32 does the saturation
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+	}
+#elif defined(__ARM_NEON)
+	const float32x4_t top = vdupq_n_f32(32767.0f), bottom = vdupq_n_f32(-32768.0f), half = vdupq_n_f32(0.5f);
+	for (unsigned int i=0; i<160; i+=4) {
+		const float32x4_t a = vld1q_f32(acc + i);
+		const uint32x4_t over = vorrq_u32(vcgtq_f32(a, top), vcltq_f32(a, bottom));
+		clipped += vgetq_lane_u32(over, 0) & 1u;
+		clipped += vgetq_lane_u32(over, 1) & 1u;
+		clipped += vgetq_lane_u32(over, 2) & 1u;
+		clipped += vgetq_lane_u32(over, 3) & 1u;
+		// round half away from zero, then vqmovn_s32 does the saturation
+		const float32x4_t r = vaddq_f32(a, vbslq_f32(vcltq_f32(a, vdupq_n_f32(0.0f)), vnegq_f32(half), half));
+		vst1_s16(out + i, vqmovn_s32(vcvtq_s32_f32(r)));
+	}
+#else
+	for (unsigned int i=0; i<160; i++) {
+		float a = acc[i];
+		if (a > 32767.0f) {
+			a = 32767.0f;
+			clipped++;
+		} else if (a < -32768.0f) {
+			a = -32768.0f;
+			clipped++;
+		}
+		out[i] = short(lrintf(a));
+	}
+#endif
+	return clipped;
+}
+
+// how fast the headroom comes back up after a source leaves, per 20 ms frame
+#define HEADROOM_RELEASE 0.05f
+
+CMixer::CMixer() : clipped(0u), headroom(1.0f)
+{
+	for (auto &s : slot) {
+		s.state = ESlotState::idle;
+		s.gain = 1.0f;
+		s.head = s.tail = s.frames = 0u;
+		s.peak = 0.0f;
+		s.ss = 0.0;
+	}
+}
+
+int CMixer::Open(float gain)
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	for (int i=0; i<MIXER_SLOTS; i++) {
+		auto &s = slot[i];
+		if (ESlotState::idle == s.state || (ESlotState::closed == s.state && s.head == s.tail)) {
+			s.state = ESlotState::open;
+			s.gain = gain;
+			s.head = s.tail = s.frames = 0u;
+			s.peak = 0.0f;
+			s.ss = 0.0;
+			return i;
+		}
+	}
+	return -1;
+}
+
+void CMixer::Push(int i, const CAudioFrame &frame)
+{
+	auto &s = slot[i];
+	// the levels are only touched by this thread, so they don't need the lock
+	const short *data = frame.GetData();
+	float peak = s.peak;
+	double ss = 0.0;
+	for (unsigned int n=0; n<160; n++) {
+		const float a = std::fabs(float(data[n]));
+		if (a > peak)
+			peak = a;
+		ss += double(data[n]) * data[n];
+	}
+	s.peak = peak;
+	s.ss += ss;
+	s.frames++;
+
+	std::unique_lock<std::mutex> lck(mtx);
+	room.wait(lck, [&s]{ return s.head - s.tail < RING; });
+	s.ring[s.head % RING] = frame;
+	s.head++;
+	cv.notify_one();
+}
+
+void CMixer::WaitEmpty(int i)
+{
+	auto &s = slot[i];
+	std::unique_lock<std::mutex> lck(mtx);
+	room.wait(lck, [&s]{ return s.head == s.tail; });
+}
+
+void CMixer::Close(int i)
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	slot[i].state = ESlotState::closed;
+	cv.notify_one();
+}
+
+SMixerLevel CMixer::GetLevel(int i) const
+{
+	const auto &s = slot[i];
+	SMixerLevel level;
+	level.frames = s.frames;
+	level.peak = (s.peak > 0.0f) ? 20.0 * log10(s.peak / 32768.0) : -99.0;
+	level.rms = (s.ss > 0.0) ? 10.0 * log10(s.ss / (160.0 * s.frames) / (32768.0 * 32768.0)) : -99.0;
+	return level;
+}
+
+// mtx must be locked
+bool CMixer::Ready() const
+{
+	for (const auto &s : slot) {
+		if (ESlotState::idle != s.state && s.head != s.tail)
+			return true;
+	}
+	return false;
+}
+
+// mtx must be locked
+bool CMixer::Idle() const
+{
+	for (const auto &s : slot) {
+		if (ESlotState::open == s.state || (ESlotState::closed == s.state && s.head != s.tail))
+			return false;
+	}
+	return true;
+}
+
+bool CMixer::IsIdle()
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	return Idle();
+}
+
+bool CMixer::Mix(short *out, int64_t &origin, int64_t &stamp)
+{
+	std::unique_lock<std::mutex> lck(mtx);
+	cv.wait(lck, [this]{ return Ready() || Idle(); });
+	// closed slots that are empty are free now
+	for (auto &s : slot) {
+		if (ESlotState::closed == s.state && s.head == s.tail)
+			s.state = ESlotState::idle;
+	}
+	if (! Ready())
+		return true;
+
+	// every source that's still there counts, even if it's late for this frame, so the level doesn't pump
+	unsigned int sources = 0u;
+	for (const auto &s : slot) {
+		if (ESlotState::open == s.state || (ESlotState::closed == s.state && s.head != s.tail))
+			sources++;
+	}
+	const float target = (sources > 1u) ? 1.0f / float(sources) : 1.0f;
+	if (target < headroom)
+		headroom = target;
+	else
+		headroom += HEADROOM_RELEASE * (target - headroom);
+
+	memset(acc, 0, sizeof(acc));
+	origin = stamp = 0;
+	for (auto &s : slot) {
+		if (ESlotState::idle == s.state || s.head == s.tail)
+			continue;	// a source that is running late just misses this frame
+		const auto &frame = s.ring[s.tail % RING];
+		Accumulate(acc, frame.GetData(), s.gain * headroom);
+		if (frame.GetOrigin() && (0 == origin || frame.GetOrigin() < origin)) {
+			origin = frame.GetOrigin();
+			stamp = frame.GetStamp();
+		}
+		s.tail++;
+	}
+	lck.unlock();
+	room.notify_all();
+	clipped += Saturate(acc, out);
+	return false;
+}
+
+unsigned int CMixer::GetClipped()
+{
+	const auto c = clipped;
+	clipped = 0u;
+	return c;
+}
@@ -0,0 +1,92 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+#include "TemplateClasses.h"
+
+// the most sources that can be mixed at once
+#define MIXER_SLOTS 8
+
+using SMixerLevel = struct mixerlevel_tag
+{
+	unsigned int frames;
+	double peak;	// dBFS
+	double rms;		// dBFS
+};
+
+// Sums several decoded 8000 samples/sec streams into one for the sound card.
+// Each source gets a slot with a small ring of 20 ms frames, filled by its
+// decoder with Push(). The playback thread calls Mix() once per 20 ms frame,
+// which adds up every source that has a frame ready, each with its own gain,
+// and saturates the sum to 16 bits. When several slots are open, the mix is
+// turned down to 1/N so N sources at full scale don't clip. It drops as
+// soon as a source joins and comes back up slowly after one leaves.
+// Nothing is allocated after construction.
+class CMixer
+{
+public:
+	CMixer();
+	// returns the slot, or -1 if they are all in use
+	int Open(float gain = 1.0f);
+	// waits while the slot's ring is full, so a source can't get too far ahead
+	void Push(int slot, const CAudioFrame &frame);
+	// waits until everything pushed into an open slot has been mixed
+	void WaitEmpty(int slot);
+	// the source is done, its slot is free once the last frame is mixed
+	void Close(int slot);
+	// the levels of what was pushed into a slot so far, only for the thread that pushes
+	SMixerLevel GetLevel(int slot) const;
+	// Waits for a frame from any source and mixes it. The stamps are from the oldest
+	// source in the mix. Returns true when every slot is closed and empty.
+	bool Mix(short *out, int64_t &origin, int64_t &stamp);
+	// no slot is open and nothing is left to mix
+	bool IsIdle();
+	// samples that had to be saturated since the last call
+	unsigned int GetClipped();
+
+private:
+	static constexpr unsigned int RING = 16;	// 320 ms
+	enum class ESlotState { idle, open, closed };
+
+	using SSlot = struct mixerslot_tag
+	{
+		ESlotState state;
+		float gain;
+		unsigned int head, tail;	// head is where the next frame goes, tail is the next to be mixed
+		CAudioFrame ring[RING];
+		// levels, kept by the pushing thread
+		unsigned int frames;
+		float peak;
+		double ss;
+	};
+
+	std::mutex mtx;
+	std::condition_variable cv, room;
+	SSlot slot[MIXER_SLOTS];
+	unsigned int clipped;
+	float headroom;	// what the whole mix is turned down by
+	float acc[160];
+
+	bool Ready() const;
+	bool Idle() const;
+};
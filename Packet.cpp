@@ -24,56 +24,61 @@
 
 static const CCRC CRC;
 
-CPacket::CPacket()
+template <size_t N> CTPacket<N>::CTPacket()
 {
-	memset(data, 0, MAX_PACKET_SIZE + 1);
+	memset(data, 0, N);
+	isstream = false;
 	size = 0;
+	rxtime = 0;
+	streamkey = 0u;
 }
 
-void CPacket::Initialize(size_t n, bool bis)
+template <size_t N> void CTPacket<N>::Initialize(size_t n, bool bis)
 {
 	memcpy(data, bis ? "M17 " : "M17P", 4);
 	size = n;
 	isstream = bis;
+	rxtime = 0;
+	streamkey = 0u;
 }
 
-uint8_t *CPacket::GetDstAddress()
+template <size_t N> uint8_t *CTPacket<N>::GetDstAddress()
 {
 	return data + (isstream ? 6u : 4u);
 }
 
-const uint8_t *CPacket::GetCDstAddress() const
+template <size_t N> const uint8_t *CTPacket<N>::GetCDstAddress() const
 {
 	return data + (isstream ? 6u : 4u);
 }
 
-uint8_t *CPacket::GetSrcAddress()
+template <size_t N> uint8_t *CTPacket<N>::GetSrcAddress()
 {
 	return data + (isstream ? 12u : 10u);
 }
 
-const uint8_t *CPacket::GetCSrcAddress() const
+template <size_t N> const uint8_t *CTPacket<N>::GetCSrcAddress() const
 {
 	return data + (isstream ? 12u : 10u);
 }
 
-uint8_t *CPacket::GetMetaData()
+template <size_t N> uint8_t *CTPacket<N>::GetMetaData()
 {
 	return data + (isstream ? 20 : 18);
 }
 
-const uint8_t *CPacket::GetCMetaData() const
+template <size_t N> const uint8_t *CTPacket<N>::GetCMetaData() const
 {
 	return data + (isstream ? 20 : 18);
 }
 
 // returns the StreamID in host byte order
-uint16_t CPacket::GetStreamId() const
+template <size_t N> uint16_t CTPacket<N>::GetStreamId() const
 {
 	return isstream ? Get16At(4) : 0u;
 }
 
-void CPacket::SetStreamId(uint16_t sid)
+template <size_t N> void CTPacket<N>::SetStreamId(uint16_t sid)
 {
 	if (isstream)
 	{
@@ -82,17 +87,17 @@ void CPacket::SetStreamId(uint16_t sid)
 }
 
 // returns LSD:TYPE in host byte order
-uint16_t CPacket::GetFrameType() const
+template <size_t N> uint16_t CTPacket<N>::GetFrameType() const
 {
 	return Get16At(isstream ? 18 : 16);
 }
 
-void CPacket::SetFrameType(uint16_t ft)
+template <size_t N> void CTPacket<N>::SetFrameType(uint16_t ft)
 {
 	Set16At(isstream ? 18 : 16, ft);
 }
 
-uint16_t CPacket::GetFrameNumber() const
+template <size_t N> uint16_t CTPacket<N>::GetFrameNumber() const
 {
 	if (isstream)
 		return Get16At(34);
@@ -100,7 +105,7 @@ uint16_t CPacket::GetFrameNumber() const
 		return 0u;
 }
 
-uint16_t CPacket::GetCRC(bool first) const
+template <size_t N> uint16_t CTPacket<N>::GetCRC(bool first) const
 {
 	uint16_t rval;
 	if (isstream)
@@ -117,7 +122,7 @@ uint16_t CPacket::GetCRC(bool first) const
 	return rval;
 }
 
-void CPacket::SetFrameNumber(uint16_t fn)
+template <size_t N> void CTPacket<N>::SetFrameNumber(uint16_t fn)
 {
 	if (isstream)
 	{
@@ -125,7 +130,7 @@ void CPacket::SetFrameNumber(uint16_t fn)
 	}
 }
 
-uint8_t *CPacket::GetVoiceData(bool firsthalf)
+template <size_t N> uint8_t *CTPacket<N>::GetVoiceData(bool firsthalf)
 {
 	if (isstream)
 		return data + (firsthalf ? 36u : 44u);
@@ -133,7 +138,7 @@ uint8_t *CPacket::GetVoiceData(bool firsthalf)
 		return 0u;
 }
 
-const uint8_t *CPacket::GetCVoiceData(bool firsthalf) const
+template <size_t N> const uint8_t *CTPacket<N>::GetCVoiceData(bool firsthalf) const
 {
 	if (isstream)
 		return data + (firsthalf ? 36u : 44u);
@@ -141,14 +146,14 @@ const uint8_t *CPacket::GetCVoiceData(bool firsthalf) const
 		return 0u;
 }
 
-bool CPacket::IsLastPacket() const
+template <size_t N> bool CTPacket<N>::IsLastPacket() const
 {
 	if (isstream and size)
 		return 0x8000u == (0x8000u & GetFrameNumber());
 	return false;
 }
 
-void CPacket::CalcCRC()
+template <size_t N> void CTPacket<N>::CalcCRC()
 {
 	if (isstream)
 	{
@@ -162,13 +167,16 @@ void CPacket::CalcCRC()
 	}
 }
 
-uint16_t CPacket::Get16At(size_t pos) const
+template <size_t N> uint16_t CTPacket<N>::Get16At(size_t pos) const
 {
 	return 0x100u * data[pos] + data[pos + 1];
 }
 
-void CPacket::Set16At(size_t pos, uint16_t val)
+template <size_t N> void CTPacket<N>::Set16At(size_t pos, uint16_t val)
 {
 	data[pos++] = 0xffu & (val >> 8);
 	data[pos]   = 0xffu & val;
 }
+
+template class CTPacket<MAX_PACKET_SIZE+1>;
+template class CTPacket<STREAM_FRAME_SIZE>;
@@ -32,11 +32,14 @@ using SM17RefPacket = struct __attribute__((__packed__)) reflector_tag {
 }; // 11 bytes (but sometimes 4 or 10 bytes)
 
 #define MAX_PACKET_SIZE 859
+// every M17 stream frame is this size
+#define STREAM_FRAME_SIZE 54
 
-class CPacket
+// N is the most bytes it can hold
+template <size_t N> class CTPacket
 {
 public:
-	CPacket();
+	CTPacket();
 	// get pointer to different parts
 	      uint8_t *GetData()        { return data; }
 	const uint8_t *GetCData() const { return data; }
@@ -65,12 +68,28 @@ public:
 	bool       IsStreamData() const { return isstream; }
 	bool       IsPacketData() const { return not isstream; }
 	bool       IsLastPacket() const;
+	// when it came off the network, in CLatency::Now() time, zero if it didn't
+	int64_t       GetRXTime() const { return rxtime; }
+	// the gateway's key for the received stream it belongs to, zero if it isn't one
+	uint32_t   GetStreamKey() const { return streamkey; }
 
 	// set state data 
 	void SetSize(size_t n) { size = n; }
 	void SetType(bool iss) { isstream = iss; }
+	void SetRXTime(int64_t ns) { rxtime = ns; }
+	void SetStreamKey(uint32_t key) { streamkey = key; }
 	void Initialize(size_t n, bool iss);
 
+	// only the part that's used is copied, and only what fits
+	template <size_t M> void CopyFrom(const CTPacket<M> &from)
+	{
+		size = (from.GetSize() < N) ? from.GetSize() : N;
+		isstream = from.IsStreamData();
+		rxtime = from.GetRXTime();
+		streamkey = from.GetStreamKey();
+		memcpy(data, from.GetCData(), size);
+	}
+
 	// calculate and set CRC value(s)
 	void CalcCRC();
 
@@ -79,5 +98,12 @@ private:
 	void Set16At(size_t pos, uint16_t val);
 	bool isstream;
 	size_t size;
-	uint8_t data[MAX_PACKET_SIZE+1];
+	int64_t rxtime;
+	uint32_t streamkey;
+	uint8_t data[N];
 };
+
+// anything that can come off the network, a stream frame or a packet mode packet
+using CPacket = CTPacket<MAX_PACKET_SIZE+1>;
+// the frames that go between the gateway, the audio manager and the recorder
+using CStreamFrame = CTPacket<STREAM_FRAME_SIZE>;
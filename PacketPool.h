@@ -0,0 +1,122 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "Packet.h"
+#include "TemplateClasses.h"
+
+// A fixed set of reusable T's, handed out as reference counted handles.
+// Everything is made when the pool is, so getting and letting go of an item
+// never touches the heap. A handle can be copied to share the item, and the
+// item goes back to the pool when the last handle to it is let go. Get() and
+// the handles can be used from any thread, and the pool has to outlive them.
+template <class T, size_t N> class CTPool
+{
+	using SSlot = struct slot_tag
+	{
+		std::atomic<unsigned> refs;
+		T item;
+	};
+
+public:
+	class CRef
+	{
+	public:
+		CRef() : pool(nullptr), slot(nullptr) {}
+		CRef(const CRef &from) : pool(from.pool), slot(from.slot) { if (slot) slot->refs++; }
+		CRef(CRef &&from) : pool(from.pool), slot(from.slot) { from.slot = nullptr; }
+		~CRef() { Reset(); }
+		CRef &operator=(const CRef &from)
+		{
+			if (this != &from)
+			{
+				if (from.slot)
+					from.slot->refs++;
+				Reset();
+				pool = from.pool;
+				slot = from.slot;
+			}
+			return *this;
+		}
+		CRef &operator=(CRef &&from)
+		{
+			if (this != &from)
+			{
+				Reset();
+				pool = from.pool;
+				slot = from.slot;
+				from.slot = nullptr;
+			}
+			return *this;
+		}
+		// let go of the item
+		void Reset()
+		{
+			if (slot && 1u == slot->refs.fetch_sub(1u, std::memory_order_acq_rel))
+				pool->Put(slot);
+			slot = nullptr;
+		}
+		explicit operator bool() const { return nullptr != slot; }
+		      T *operator->()       { return &slot->item; }
+		const T *operator->() const { return &slot->item; }
+		      T &operator*()       { return slot->item; }
+		const T &operator*() const { return slot->item; }
+
+	private:
+		friend class CTPool;
+		CRef(CTPool *p, SSlot *s) : pool(p), slot(s) {}
+		CTPool *pool;
+		SSlot *slot;
+	};
+
+	CTPool() : slots(new SSlot[N])
+	{
+		for (unsigned i=0; i<N; i++)
+		{
+			slots[i].refs = 0u;
+			spare.Push(i);
+		}
+	}
+
+	// the handle is empty if they're all in use
+	CRef Get()
+	{
+		unsigned i;
+		if (spare.Pop(i))
+			return CRef();
+		slots[i].refs.store(1u, std::memory_order_relaxed);
+		return CRef(this, &slots[i]);
+	}
+
+private:
+	std::unique_ptr<SSlot[]> slots;
+	CTBoundedQueue<unsigned, N> spare;
+
+	void Put(SSlot *slot) { spare.Push(unsigned(slot - slots.get())); }
+};
+
+// the stream frames that go between the gateway, the audio manager and the recorder
+// there are enough for a full recorder queue, full frame channels and a pending stream
+using CFramePool = CTPool<CStreamFrame, 4096>;
+using CFrameRef = CFramePool::CRef;
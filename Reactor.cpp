@@ -0,0 +1,186 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+#include "Reactor.h"
+
+static struct timespec Add(const struct timespec &t, double seconds)
+{
+	struct timespec r;
+	const long long ns = (long long)(seconds * 1.0e9);
+	r.tv_sec = t.tv_sec + time_t(ns / 1000000000ll);
+	r.tv_nsec = t.tv_nsec + long(ns % 1000000000ll);
+	if (r.tv_nsec >= 1000000000l) {
+		r.tv_sec++;
+		r.tv_nsec -= 1000000000l;
+	}
+	return r;
+}
+
+bool CDeadline::Open()
+{
+	Close();
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		std::cerr << "timerfd_create() failed: " << strerror(errno) << std::endl;
+		return true;
+	}
+	return false;
+}
+
+void CDeadline::Close()
+{
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+	armed = false;
+}
+
+void CDeadline::Arm(double seconds, double every)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	due = Add(now, seconds);
+	interval = every;
+	// it's an absolute time, so it expires exactly when it's due, no matter how long it took to get here
+	struct itimerspec its;
+	its.it_value = due;
+	its.it_interval.tv_sec = time_t(every);
+	its.it_interval.tv_nsec = long((every - double(its.it_interval.tv_sec)) * 1.0e9);
+	if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, nullptr))
+		std::cerr << "timerfd_settime() failed: " << strerror(errno) << std::endl;
+	armed = true;
+}
+
+void CDeadline::Disarm()
+{
+	struct itimerspec its;
+	memset(&its, 0, sizeof(its));
+	timerfd_settime(fd, 0, &its, nullptr);
+	// it may have already expired
+	uint64_t count;
+	while (read(fd, &count, sizeof(count)) > 0)
+		;
+	armed = false;
+}
+
+double CDeadline::Expired()
+{
+	uint64_t count = 0;
+	if (read(fd, &count, sizeof(count)) != sizeof(count) || 0 == count)
+		return 0.0;	// it was disarmed after the reactor saw it
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	// the last time it was due
+	const auto last = Add(due, interval * double(count - 1));
+	const double late = (now.tv_sec - last.tv_sec) * 1.0e6 + (now.tv_nsec - last.tv_nsec) / 1.0e3;
+	if (interval > 0.0)
+		due = Add(last, interval);
+	else
+		armed = false;
+	return (late > 0.0) ? late : 0.0;
+}
+
+bool CReactor::Open()
+{
+	Close();
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		std::cerr << "epoll_create1() failed: " << strerror(errno) << std::endl;
+		return true;
+	}
+	wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wakefd < 0) {
+		std::cerr << "eventfd() failed: " << strerror(errno) << std::endl;
+		Close();
+		return true;
+	}
+	return Add(wakefd, WAKE_TAG);
+}
+
+void CReactor::Close()
+{
+	if (wakefd >= 0) {
+		close(wakefd);
+		wakefd = -1;
+	}
+	if (epfd >= 0) {
+		close(epfd);
+		epfd = -1;
+	}
+}
+
+bool CReactor::Add(int fd, int tag)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u64 = uint64_t(uint32_t(tag));
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+		std::cerr << "epoll_ctl() failed: " << strerror(errno) << std::endl;
+		return true;
+	}
+	return false;
+}
+
+void CReactor::Remove(int fd)
+{
+	if (epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr))
+		std::cerr << "epoll_ctl() failed: " << strerror(errno) << std::endl;
+}
+
+void CReactor::Wake()
+{
+	const uint64_t one = 1;
+	if (write(wakefd, &one, sizeof(one)) < 0)
+		std::cerr << "Could not wake the reactor: " << strerror(errno) << std::endl;
+}
+
+int CReactor::Wait(int *tags, int max)
+{
+	struct epoll_event ev[16];
+	if (max > 16)
+		max = 16;
+	int n;
+	do {
+		n = epoll_wait(epfd, ev, max, -1);
+	} while (n < 0 && EINTR == errno);
+	if (n < 0) {
+		std::cerr << "epoll_wait() error: " << strerror(errno) << std::endl;
+		return -1;
+	}
+	for (int i=0; i<n; i++) {
+		tags[i] = int(uint32_t(ev[i].data.u64));
+		if (WAKE_TAG == tags[i]) {
+			uint64_t count;
+			if (read(wakefd, &count, sizeof(count)) < 0 && EAGAIN != errno)
+				std::cerr << "Could not read the wake-up eventfd: " << strerror(errno) << std::endl;
+		}
+	}
+	return n;
+}
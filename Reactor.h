@@ -0,0 +1,70 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#pragma once
+
+#include <ctime>
+
+// A timerfd that expires at a deadline, and then every interval if there is one.
+// It's added to a reactor like any other fd, and Expired() is called when it's ready.
+class CDeadline
+{
+public:
+	CDeadline() : fd(-1), armed(false), interval(0.0) {}
+	~CDeadline() { Close(); }
+	// returns true on failure
+	bool Open();
+	void Close();
+	int GetFD() const { return fd; }
+	// expire this many seconds from now
+	void Arm(double seconds, double every = 0.0);
+	void Disarm();
+	bool IsArmed() const { return armed; }
+	// returns how late it was, in microseconds
+	double Expired();
+
+private:
+	int fd;
+	bool armed;
+	double interval;
+	struct timespec due;
+};
+
+// Waits on any number of fds with epoll, each one comes back with the tag it was added with.
+class CReactor
+{
+public:
+	CReactor() : epfd(-1), wakefd(-1) {}
+	~CReactor() { Close(); }
+	// returns true on failure
+	bool Open();
+	void Close();
+	// wait for the fd to be readable, returns true on failure
+	bool Add(int fd, int tag);
+	void Remove(int fd);
+	// from any thread, Wait() will return WAKE_TAG
+	void Wake();
+	// blocks until something is ready, fills in the tags and returns how many, or -1 on failure
+	int Wait(int *tags, int max);
+
+	static constexpr int WAKE_TAG = -1;
+
+private:
+	int epfd, wakefd;
+};
@@ -0,0 +1,363 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+#include "Recorder.h"
+#include "Callsign.h"
+#include "codec2.h"
+
+// a stream that hasn't been heard from in this long lost its last frame, in microseconds
+#define STREAM_TIMEOUT 2000000
+// how often the raw file is flushed, in microseconds
+#define FLUSH_INTERVAL 1000000
+CRecorder::CRecorder() : running(false), asleep(false), wakefd(-1), unflushed(false), dropped(0u), as_wav(false) {}
+
+CRecorder::~CRecorder()
+{
+	Stop();
+}
+
+int64_t CRecorder::WallClock()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static bool MakeFolder(const std::string &path)
+{
+	for (size_t pos=path.find('/', 1); ; pos=path.find('/', pos+1)) {
+		const std::string part(path.substr(0, pos));
+		if (mkdir(part.c_str(), 0755) && EEXIST != errno) {
+			std::cerr << "Could not make " << part << ": " << strerror(errno) << std::endl;
+			return true;
+		}
+		if (std::string::npos == pos)
+			return false;
+	}
+}
+
+bool CRecorder::Start(const std::string &path, bool wav)
+{
+	if (running)
+		return false;
+	folder.assign(path);
+	while (folder.size() > 1 && '/' == folder.back())
+		folder.pop_back();
+	if (folder.empty() || MakeFolder(folder))
+		return true;
+	as_wav = wav;
+	dropped = 0u;
+	wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wakefd < 0) {
+		std::cerr << "Could not make the recorder's eventfd: " << strerror(errno) << std::endl;
+		return true;
+	}
+	running = true;
+	try {
+		thread = std::thread(&CRecorder::Loop, this);
+	} catch (const std::system_error &e) {
+		std::cerr << "Could not start the recorder thread: " << e.what() << std::endl;
+		running = false;
+		close(wakefd);
+		wakefd = -1;
+		return true;
+	}
+	pthread_setname_np(thread.native_handle(), "mv-recorder");
+	std::cout << "Recording streams to " << folder << (as_wav ? " as WAV files" : "") << std::endl;
+	return false;
+}
+
+void CRecorder::Stop()
+{
+	if (! thread.joinable())
+		return;
+	running = false;
+	Wake();
+	thread.join();
+	close(wakefd);
+	wakefd = -1;
+	while (! streams.empty())
+		Close(streams.back().get());
+	today.reset();
+	if (dropped)
+		std::cerr << "The recorder fell behind and dropped " << dropped << " packets" << std::endl;
+}
+
+void CRecorder::Put(const CFrameRef &frame, ERecordDir dir)
+{
+	if (! running || ! frame)
+		return;
+	SRecordItem item;
+	item.time = WallClock();
+	item.dir = dir;
+	item.frame = frame;
+	if (queue.Push(std::move(item))) {
+		dropped++;
+		return;
+	}
+	// the writer looks at the queue again after it says it's asleep, so one of us sees the other
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (asleep.exchange(false))
+		Wake();
+}
+
+void CRecorder::Wake()
+{
+	const uint64_t one = 1u;
+	if (write(wakefd, &one, sizeof(one)) < 0 && EAGAIN != errno)
+		std::cerr << "Could not wake the recorder: " << strerror(errno) << std::endl;
+}
+
+// how long the writer can sleep before a stream times out or the raw file needs a flush, -1 is forever
+int CRecorder::SleepTime(int64_t now, int64_t flushed) const
+{
+	int64_t due = unflushed ? flushed + FLUSH_INTERVAL : INT64_MAX;
+	for (const auto &s : streams)
+		due = std::min(due, s->last + STREAM_TIMEOUT);
+	if (INT64_MAX == due)
+		return -1;
+	return int(std::min(std::max(due - now, int64_t(0)), int64_t(FLUSH_INTERVAL)) / 1000) + 1;
+}
+
+void CRecorder::Loop()
+{
+	int64_t flushed = WallClock();
+	SRecordItem item;
+	for (;;) {
+		if (queue.Pop(item)) {
+			// nothing to write, so it's a good time for the housekeeping
+			const auto now = WallClock();
+			CloseIdle(now);
+			if (unflushed && now - flushed > FLUSH_INTERVAL) {
+				if (today && today->data)
+					fflush(today->data);
+				unflushed = false;
+				flushed = now;
+			}
+			if (! running)
+				break;	// only after the queue is empty
+			asleep = true;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (! queue.Pop(item)) {
+				// it came in while we were getting ready to sleep
+				asleep = false;
+				Write(item);
+				item.frame.Reset();
+				continue;
+			}
+			struct pollfd pfd = { wakefd, POLLIN, 0 };
+			if (poll(&pfd, 1, SleepTime(now, flushed)) < 0 && EINTR != errno)
+				std::cerr << "The recorder's poll() failed: " << strerror(errno) << std::endl;
+			asleep = false;
+			uint64_t count;
+			if (read(wakefd, &count, sizeof(count)) < 0 && EAGAIN != errno)
+				std::cerr << "Could not read the recorder's eventfd: " << strerror(errno) << std::endl;
+			continue;
+		}
+		Write(item);
+		item.frame.Reset();	// back to the pool
+	}
+}
+
+void CRecorder::Write(const SRecordItem &item)
+{
+	const auto &pack = *item.frame;
+	const auto sid = pack.GetStreamId();
+	const auto key = pack.GetStreamKey();
+	SStream *stream = nullptr;
+	for (auto &s : streams) {
+		if (sid == s->sid && key == s->key && item.dir == s->dir) {
+			stream = s.get();
+			break;
+		}
+	}
+	if (nullptr == stream) {
+		stream = Open(item, pack);
+		if (nullptr == stream)
+			return;
+	}
+
+	if (stream->wav) {
+		// both C2 3200 and C2 1600 are 40 ms of audio per M17 frame
+		short audio[320];
+		if (stream->is_3200) {
+			stream->codec->codec2_decode(audio, pack.GetCVoiceData());
+			stream->codec->codec2_decode(audio+160, pack.GetCVoiceData(false));
+		} else {
+			stream->codec->codec2_decode(audio, pack.GetCVoiceData());
+		}
+		stream->wav->Write(audio, 320);
+	} else {
+		// the time, which way it went and the packet just as it was on the network
+		uint8_t record[RECORD_SIZE] = { 0 };
+		for (int i=0; i<8; i++)
+			record[i] = uint8_t(item.time >> (8 * i));
+		record[8] = (ERecordDir::rx == item.dir) ? 'R' : 'T';
+		memcpy(record + RECORD_SIZE - PACKET_SIZE, pack.GetCData(), PACKET_SIZE);
+		if (RECORD_SIZE != fwrite(record, 1, RECORD_SIZE, stream->day->data))
+			std::cerr << "Could not write to the " << stream->day->day << " archive: " << strerror(errno) << std::endl;
+		unflushed = true;
+	}
+	stream->last = item.time;
+	stream->frames++;
+
+	if (pack.IsLastPacket())
+		Close(stream);
+}
+
+CRecorder::SStream *CRecorder::Open(const SRecordItem &item, const CStreamFrame &pack)
+{
+	std::unique_ptr<SStream> stream(new SStream);
+	stream->sid = pack.GetStreamId();
+	stream->key = pack.GetStreamKey();
+	stream->dir = item.dir;
+	stream->is_3200 = ((pack.GetFrameType() & 0x6u) == 0x4u);
+	stream->src.assign(CCallsign(pack.GetCSrcAddress()).GetCS());
+	stream->dst.assign(CCallsign(pack.GetCDstAddress()).GetCS());
+	stream->start = stream->last = item.time;
+	stream->frames = 0u;
+	stream->day = Day(item.time);
+	if (! stream->day)
+		return nullptr;
+
+	if (as_wav) {
+		// one file for each stream, in a folder for the day
+		const time_t t = item.time / 1000000;
+		struct tm tm;
+		localtime_r(&t, &tm);
+		char name[64];
+		strftime(name, sizeof(name), "%H%M%S", &tm);
+		std::string src(stream->src);
+		for (auto &c : src) {
+			if (' ' == c || '/' == c)
+				c = '_';
+		}
+		while (src.size() && '_' == src.back())
+			src.pop_back();
+		stream->file.assign(stream->day->day + "/" + name + "-" + src + "-" + std::to_string(stream->sid) + ".wav");
+		const std::string path(folder + "/" + stream->file);
+		if (MakeFolder(folder + "/" + stream->day->day))
+			return nullptr;
+		SAudioOptions opts;
+		opts.paced = opts.loop = opts.mmap = false;
+		opts.periods = opts.start = 0u;
+		stream->wav = CAudioDevice::Open("file:" + path, EAudioDirection::playback, 8000u, 160u, opts);
+		if (! stream->wav)
+			return nullptr;
+		stream->codec.reset(new CCodec2(stream->is_3200));
+		stream->offset = 44;	// the canonical WAV header
+	} else {
+		stream->file.assign(stream->day->day + ".m17");
+		stream->offset = ftell(stream->day->data);
+	}
+	streams.push_back(std::move(stream));
+	return streams.back().get();
+}
+
+void CRecorder::Close(SStream *stream)
+{
+	if (stream->wav)
+		stream->wav->Close(true);
+	// the date and time the stream started
+	const time_t t = stream->start / 1000000;
+	struct tm tm;
+	localtime_r(&t, &tm);
+	char start[32];
+	strftime(start, sizeof(start), "%Y-%m-%dT%H:%M:%S", &tm);
+	const unsigned long ms = (stream->last - stream->start) / 1000 + 40;
+	auto src(stream->src), dst(stream->dst);
+	while (src.size() && ' ' == src.back())
+		src.pop_back();
+	while (dst.size() && ' ' == dst.back())
+		dst.pop_back();
+	fprintf(stream->day->index, "%04x\t%s\t%s\t%s\t%s\t%lu\t%s\t%s\t%ld\t%u\n", stream->sid, (ERecordDir::rx == stream->dir) ? "RX" : "TX", src.c_str(), dst.c_str(), start, ms, stream->is_3200 ? "3200" : "1600", stream->file.c_str(), stream->offset, stream->frames);
+	fflush(stream->day->index);
+
+	for (auto it=streams.begin(); it!=streams.end(); it++) {
+		if (it->get() == stream) {
+			streams.erase(it);
+			break;
+		}
+	}
+}
+
+void CRecorder::CloseIdle(int64_t now)
+{
+	for (size_t i=0; i<streams.size(); ) {
+		if (now - streams[i]->last > STREAM_TIMEOUT)
+			Close(streams[i].get());	// it's erased, so i is already the next one
+		else
+			i++;
+	}
+}
+
+std::shared_ptr<CRecorder::SDayFile> CRecorder::Day(int64_t time)
+{
+	const time_t t = time / 1000000;
+	struct tm tm;
+	localtime_r(&t, &tm);
+	char day[16];
+	strftime(day, sizeof(day), "%Y-%m-%d", &tm);
+	if (today && today->day == day)
+		return today;
+
+	// it's a new day, streams that started yesterday keep the old files until they're done
+	std::shared_ptr<SDayFile> file(new SDayFile, &CRecorder::CloseDay);
+	file->day.assign(day);
+	file->data = nullptr;
+	const std::string base(folder + "/" + day);
+	file->index = fopen((base + ".idx").c_str(), "a");
+	if (nullptr == file->index) {
+		std::cerr << "Could not open " << base << ".idx: " << strerror(errno) << std::endl;
+		return nullptr;
+	}
+	fseek(file->index, 0, SEEK_END);
+	if (0 == ftell(file->index)) {
+		fprintf(file->index, "# sid\tdir\tsource\tdestination\tstart\tms\tmode\tfile\toffset\tframes\n");
+		fflush(file->index);
+	}
+	if (! as_wav) {
+		file->data = fopen((base + ".m17").c_str(), "ab");
+		if (nullptr == file->data) {
+			std::cerr << "Could not open " << base << ".m17: " << strerror(errno) << std::endl;
+			return nullptr;	// the index is closed by CloseDay()
+		}
+		fseek(file->data, 0, SEEK_END);
+	}
+	today = file;
+	return today;
+}
+
+void CRecorder::CloseDay(SDayFile *day)
+{
+	if (day->data)
+		fclose(day->data);
+	if (day->index)
+		fclose(day->index);
+	delete day;
+}
@@ -0,0 +1,117 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TemplateClasses.h"
+#include "PacketPool.h"
+#include "AudioDevice.h"
+
+class CCodec2;
+
+enum class ERecordDir { rx, tx };
+
+// Archives M17 voice streams to disk.
+// Put() is called on the audio threads with every stream packet and only
+// copies it into a lock-free queue. A writer thread empties the queue, so a
+// slow disk can only cost us recorded frames, never audio. The writer sleeps
+// on an eventfd when the queue is empty, and Put() only writes to it when it
+// finds the writer asleep, so an idle recorder doesn't wake up at all.
+// Streams are either appended to one raw file per day, each packet as it
+// came off the network with a timestamp, or decoded into a WAV file each.
+// Either way, every stream gets a line in a per-day index file.
+class CRecorder
+{
+public:
+	CRecorder();
+	~CRecorder();
+	// returns true on failure
+	bool Start(const std::string &path, bool wav);
+	// closes whatever streams are still open
+	void Stop();
+	bool IsRunning() const { return running; }
+	// never blocks and never touches the disk
+	void Put(const CFrameRef &frame, ERecordDir dir);
+	// packets thrown away because the writer fell behind
+	unsigned int GetDropped() const { return dropped; }
+
+private:
+	// every record in the raw file is this size
+	static constexpr size_t RECORD_SIZE = 64u;
+	static constexpr size_t PACKET_SIZE = 54u;
+
+	using SRecordItem = struct recorditem_tag
+	{
+		int64_t time;	// wall clock, in microseconds
+		ERecordDir dir;
+		CFrameRef frame;	// shared with whoever else has it, so it's not copied
+	};
+
+	using SDayFile = struct dayfile_tag
+	{
+		std::string day;
+		FILE *data, *index;
+	};
+
+	using SStream = struct recordstream_tag
+	{
+		uint16_t sid;
+		uint32_t key;	// the gateway's stream key, zero for what we send
+		ERecordDir dir;
+		bool is_3200;
+		std::string src, dst, file;
+		int64_t start, last;	// microseconds
+		long offset;			// of the first record in the day file, or of the audio in the WAV file
+		unsigned int frames;
+		std::shared_ptr<SDayFile> day;
+		std::unique_ptr<CAudioDevice> wav;
+		std::unique_ptr<CCodec2> codec;
+	};
+
+	// twenty seconds of four streams, plus one going out
+	CTBoundedQueue<SRecordItem, 2048> queue;
+	std::atomic<bool> running, asleep;
+	int wakefd;
+	bool unflushed;	// the raw file has been written to since it was flushed
+	std::atomic<unsigned int> dropped;
+	std::thread thread;
+	std::string folder;
+	bool as_wav;
+	std::shared_ptr<SDayFile> today;
+	std::vector<std::unique_ptr<SStream>> streams;
+
+	void Loop();
+	void Write(const SRecordItem &item);
+	SStream *Open(const SRecordItem &item, const CStreamFrame &pack);
+	void Close(SStream *stream);
+	void CloseIdle(int64_t now);
+	int SleepTime(int64_t now, int64_t flushed) const;
+	void Wake();
+	std::shared_ptr<SDayFile> Day(int64_t time);
+	static void CloseDay(SDayFile *day);
+	static int64_t WallClock();
+};
@@ -0,0 +1,108 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include <cstring>
+
+#include "ReplayBuffer.h"
+
+void CReplayBuffer::Init(unsigned int minutes, unsigned int lanes)
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	capacity = 1500u * minutes;	// an M17 frame is 40 ms
+	ring.assign(capacity, SReplayFrame());
+	total = 0u;
+	SReplayStream none;
+	none.serial = 0u;
+	active.assign(lanes, none);
+	streams.clear();
+}
+
+void CReplayBuffer::Start(unsigned int lane, uint16_t sid, bool is_3200, const std::string &src, const std::string &dst)
+{
+	if (0u == capacity || lane >= active.size())
+		return;
+	std::lock_guard<std::mutex> lck(mtx);
+	auto &s = active[lane];
+	if (0u == ++serial)
+		serial = 1u;
+	s.serial = serial;
+	s.sid = sid;
+	s.is_3200 = is_3200;
+	s.src.assign(src);
+	s.dst.assign(dst);
+	s.start = time(nullptr);
+	s.first = s.end = total;
+}
+
+void CReplayBuffer::Add(unsigned int lane, const uint8_t *payload)
+{
+	if (0u == capacity || lane >= active.size())
+		return;
+	std::lock_guard<std::mutex> lck(mtx);
+	auto &s = active[lane];
+	if (0u == s.serial)
+		return;
+	auto &f = ring[total % capacity];
+	f.serial = s.serial;
+	memcpy(f.payload, payload, 16);
+	s.end = ++total;
+}
+
+void CReplayBuffer::End(unsigned int lane)
+{
+	if (0u == capacity || lane >= active.size())
+		return;
+	std::lock_guard<std::mutex> lck(mtx);
+	auto &s = active[lane];
+	if (s.serial && s.end > s.first)
+		streams.push_back(s);
+	s.serial = 0u;
+	// forget the ones that are completely gone
+	while (! streams.empty() && streams.front().end <= Oldest())
+		streams.pop_front();
+}
+
+std::vector<SReplayStream> CReplayBuffer::GetStreams()
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	std::vector<SReplayStream> rval;
+	for (const auto &s : streams) {
+		if (s.end > Oldest())
+			rval.push_back(s);
+	}
+	return rval;
+}
+
+bool CReplayBuffer::Get(const SReplayStream &stream, uint64_t &pos, uint8_t *payload)
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	if (pos < stream.first)
+		pos = stream.first;
+	if (pos < Oldest())
+		pos = Oldest();	// the beginning is gone, play what's left
+	for (; pos<stream.end; pos++) {
+		const auto &f = ring[pos % capacity];
+		if (f.serial == stream.serial) {
+			memcpy(payload, f.payload, 16);
+			pos++;
+			return false;
+		}
+	}
+	return true;
+}
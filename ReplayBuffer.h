@@ -0,0 +1,77 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <deque>
+#include <string>
+#include <vector>
+
+using SReplayStream = struct replaystream_tag
+{
+	uint32_t serial;	// tags the stream's frames in the ring
+	uint16_t sid;
+	bool is_3200;
+	std::string src, dst;
+	time_t start;
+	uint64_t first, end;	// where its frames are in the ring, counted from the beginning of time
+};
+
+// The codec2 payloads of the last few minutes of received streams, for an
+// instant replay. The room is set aside once by Init() and the oldest frames
+// are written over. Streams heard at the same time are interleaved, so each
+// frame is tagged with its stream. Every RX lane adds to it, and a replay can
+// read it while they do, so it has a lock, but it's only held to copy a frame.
+class CReplayBuffer
+{
+public:
+	CReplayBuffer() : capacity(0u), total(0u), serial(0u) {}
+	// room for this many minutes of M17 voice, nothing is kept if it's zero
+	void Init(unsigned int minutes, unsigned int lanes);
+	bool IsEnabled() const { return capacity > 0u; }
+	// on the lane's decode thread, around its stream
+	void Start(unsigned int lane, uint16_t sid, bool is_3200, const std::string &src, const std::string &dst);
+	// one 16-byte M17 payload, 40 ms of audio
+	void Add(unsigned int lane, const uint8_t *payload);
+	void End(unsigned int lane);
+	// the finished streams that are still at least partly here, oldest first
+	std::vector<SReplayStream> GetStreams();
+	// Copies the next frame of the stream at or after pos, and moves pos past it.
+	// returns true when there are no more, or the rest has been written over
+	bool Get(const SReplayStream &stream, uint64_t &pos, uint8_t *payload);
+
+private:
+	using SReplayFrame = struct replayframe_tag
+	{
+		uint32_t serial;
+		uint8_t payload[16];
+	};
+
+	std::mutex mtx;
+	std::vector<SReplayFrame> ring;
+	uint64_t capacity, total;
+	uint32_t serial;
+	std::vector<SReplayStream> active;	// one for each lane, serial 0 is none
+	std::deque<SReplayStream> streams;
+
+	uint64_t Oldest() const { return (total > capacity) ? total - capacity : 0u; }
+};
@@ -29,7 +29,7 @@
 
 static const char *notfoundstr = _(" not found");
 
-CSettingsDlg::CSettingsDlg() : pMainWindow(nullptr), pDlg(nullptr)
+CSettingsDlg::CSettingsDlg() : pMainWindow(nullptr), pDlg(nullptr), tunedin(0), tunedout(0)
 {
 	LatRegEx = std::regex("^[+-]?(90|([1-8]?[0-9](\\.[0-9]*)?))$", std::regex::extended);
 	LongRegEx = std::regex("^[+-]?(180|(((1[0-7])|[1-9]?)[0-9](\\.[0-9]*)?))$", std::regex::extended);
@@ -85,6 +85,34 @@ void CSettingsDlg::SaveWidgetStates(CFGDATA &d)
 	d.dLatitude = std::atof(pLatitudeInput->value());
 	d.dLongitude = std::atof(pLongitudeInput->value());
 	d.sMessage.assign(pTextMessageInput->value());
+	// real-time settings are only in mvoice.cfg
+	d.eRTPolicy = data.eRTPolicy;
+	d.iAudioPriority = data.iAudioPriority;
+	d.iGatewayPriority = data.iGatewayPriority;
+	d.iAudioCPU = data.iAudioCPU;
+	d.iGatewayCPU = data.iGatewayCPU;
+	d.bLockMemory = data.bLockMemory;
+	d.bGatewayIOUring = data.bGatewayIOUring;
+	d.bAudioFilePaced = data.bAudioFilePaced;
+	d.bAudioFileLoop = data.bAudioFileLoop;
+	d.bTXPreemptsRX = data.bTXPreemptsRX;
+	d.bAudioMMap = data.bAudioMMap;
+	d.iAudioInPeriods = int(pInPeriodsSpinner->value());
+	d.iAudioOutPeriods = int(pOutPeriodsSpinner->value());
+	d.iAudioStartPeriods = int(pStartPeriodsSpinner->value());
+	d.bDriftCompensation = data.bDriftCompensation;
+	d.iRXStreams = data.iRXStreams;
+	d.sRXGains.assign(data.sRXGains);
+	d.iEchoSeconds = data.iEchoSeconds;
+	d.iReplayMinutes = data.iReplayMinutes;
+	d.iTXHighPass = data.iTXHighPass;
+	d.bTXAGC = data.bTXAGC;
+	d.iTXAGCTarget = data.iTXAGCTarget;
+	d.bTXLimiter = data.bTXLimiter;
+	d.bRecordRX = data.bRecordRX;
+	d.bRecordTX = data.bRecordTX;
+	d.bRecordWAV = data.bRecordWAV;
+	d.sRecordPath.assign(data.sRecordPath);
 	// Internet
 	if (pIPv4RadioButton->value())
 		d.eNetType = EInternetType::ipv4only;
@@ -133,6 +161,10 @@ void CSettingsDlg::SetWidgetStates(const CFGDATA &d)
 #ifndef NO_DHT
 	pBootstrapInput->value(d.sBootstrap.c_str());
 #endif
+	// latency
+	pInPeriodsSpinner->value(d.iAudioInPeriods);
+	pOutPeriodsSpinner->value(d.iAudioOutPeriods);
+	pStartPeriodsSpinner->value(d.iAudioStartPeriods);
 	// internet
 	switch (d.eNetType) {
 		case EInternetType::ipv6only:
@@ -279,6 +311,43 @@ bool CSettingsDlg::Init(CMainWindow *pMain)
 	pAudioGroup->end();
 	pTabs->add(pAudioGroup);
 
+	//////////////////////////////////////////////////////////////////////////
+	pLatencyGroup = new Fl_Group(20, 30, 410, 210, _("Latency"));
+	pLatencyGroup->tooltip(_("The sound card buffers, in 20 ms periods, zero lets the driver decide"));
+	pLatencyGroup->labelsize(16);
+
+	pInPeriodsSpinner = new Fl_Spinner(300, 45, 60, 26, _("Input buffer periods:"));
+	pInPeriodsSpinner->tooltip(_("A smaller input buffer is less delay, but may overrun"));
+	pInPeriodsSpinner->labelsize(16);
+	pInPeriodsSpinner->textsize(16);
+	pInPeriodsSpinner->range(0, MAX_BUFFER_PERIODS);
+	pInPeriodsSpinner->step(1);
+
+	pOutPeriodsSpinner = new Fl_Spinner(300, 80, 60, 26, _("Output buffer periods:"));
+	pOutPeriodsSpinner->tooltip(_("A smaller output buffer is less delay, but may underrun"));
+	pOutPeriodsSpinner->labelsize(16);
+	pOutPeriodsSpinner->textsize(16);
+	pOutPeriodsSpinner->range(0, MAX_BUFFER_PERIODS);
+	pOutPeriodsSpinner->step(1);
+
+	pStartPeriodsSpinner = new Fl_Spinner(300, 115, 60, 26, _("Start playing after periods:"));
+	pStartPeriodsSpinner->tooltip(_("How much audio is queued before the sound card starts to play it"));
+	pStartPeriodsSpinner->labelsize(16);
+	pStartPeriodsSpinner->textsize(16);
+	pStartPeriodsSpinner->range(0, MAX_BUFFER_PERIODS);
+	pStartPeriodsSpinner->step(1);
+
+	pAutoTuneButton = new Fl_Button(170, 155, 110, 34, _("Auto-tune"));
+	pAutoTuneButton->tooltip(_("Find the smallest buffers your sound card can run without xruns"));
+	pAutoTuneButton->labelsize(16);
+	pAutoTuneButton->callback(&CSettingsDlg::AutoTuneButtonCB, this);
+
+	pAutoTuneBox = new Fl_Box(30, 200, 390, 25);
+	pAutoTuneBox->labelsize(12);
+
+	pLatencyGroup->end();
+	pTabs->add(pLatencyGroup);
+
 	pTabs->end();
 
 	pOkayButton = new Fl_Return_Button(310, 280, 120, 44, _("Update"));
@@ -429,11 +498,67 @@ void CSettingsDlg::AudioOutputChoice()
 	}
 }
 
+void CSettingsDlg::AutoTuneButtonCB(Fl_Widget *, void *This)
+{
+	((CSettingsDlg *)This)->AutoTuneButton();
+}
+
+void CSettingsDlg::AutoTuneButton()
+{
+	// the devices selected in the Audio tab, which may not have been saved yet
+	if (0 == data.sAudioIn.compare("ERROR") || 0 == data.sAudioOut.compare("ERROR")) {
+		pAutoTuneBox->label(_("Select the audio devices first"));
+		return;
+	}
+	if (pMainWindow->AudioManager.AutoTune(data.sAudioIn, data.sAudioOut, [this](int in, int out) {
+		tunedin = in;
+		tunedout = out;
+		Fl::awake(&CSettingsDlg::AutoTuneDoneCB, this);
+	})) {
+		pAutoTuneBox->label(_("The audio is busy, try again when it's quiet"));
+		return;
+	}
+	pAutoTuneButton->deactivate();
+	pMainWindow->SetTuning(true);
+	pAutoTuneBox->label(_("Tuning, this can take a minute..."));
+}
+
+void CSettingsDlg::AutoTuneDoneCB(void *This)
+{
+	((CSettingsDlg *)This)->AutoTuneDone();
+}
+
+// on the GUI thread, the results are only used if the dialog is updated
+void CSettingsDlg::AutoTuneDone()
+{
+	pAutoTuneButton->activate();
+	pMainWindow->SetTuning(false);
+	if (tunedin)
+		pInPeriodsSpinner->value(tunedin);
+	if (tunedout) {
+		pOutPeriodsSpinner->value(tunedout);
+		pStartPeriodsSpinner->value(tunedout);
+	}
+	tunestatus.assign(_("Tuned input: "));
+	tunestatus.append(tunedin ? std::to_string(tunedin) : std::string("-"));
+	tunestatus.append(_(", output: "));
+	tunestatus.append(tunedout ? std::to_string(tunedout) : std::string("-"));
+	tunestatus.append(_(" periods"));
+	pAutoTuneBox->label(tunestatus.c_str());
+}
+
 void CSettingsDlg::AudioRescanButtonCB(Fl_Widget *, void *This)
 {
 	((CSettingsDlg *)This)->AudioRescanButton();
 }
 
+// menu items can't have a '/', so just use the file name
+static std::string FileDeviceName(const std::string &device)
+{
+	auto pos = device.rfind('/');
+	return std::string("file:") + ((device.npos == pos) ? device.substr(5) : device.substr(pos+1));
+}
+
 void CSettingsDlg::AudioRescanButton()
 {
 	auto inchoice = pAudioInputChoice->value();
@@ -442,15 +567,18 @@ void CSettingsDlg::AudioRescanButton()
 	auto outchoice = pAudioOutputChoice->value();
 	if (outchoice < 0)
 		outchoice = 0;
-	void **hints;
-	if (snd_device_name_hint(-1, "pcm", &hints) < 0)
-		return;
-	void **n = hints;
+	// AudioInputChoice() and AudioOutputChoice() will overwrite these
+	const std::string cfgin(data.sAudioIn), cfgout(data.sAudioOut);
 	pAudioInputChoice->clear();
 	pAudioOutputChoice->clear();
 	AudioInMap.clear();
 	AudioOutMap.clear();
-	while (*n != NULL) {
+	// with no sound card at all, there may still be a file device
+	void **hints;
+	if (snd_device_name_hint(-1, "pcm", &hints) < 0)
+		hints = nullptr;
+	void **n = hints;
+	while (n && *n != NULL) {
 		char *name = snd_device_name_get_hint(*n, "NAME");
 		if (NULL == name) {
 			n++;
@@ -516,7 +644,19 @@ void CSettingsDlg::AudioRescanButton()
 		}
 		n++;
 	}
-	snd_device_name_free_hint(hints);
+	if (hints)
+		snd_device_name_free_hint(hints);
+	// a "file:" device can only come from mvoice.cfg, keep it selectable
+	if (CAudioDevice::IsFile(cfgin)) {
+		const std::string short_name(FileDeviceName(cfgin));
+		AudioInMap[short_name] = std::pair<std::string, std::string>(cfgin, cfgin.substr(5));
+		inchoice = pAudioInputChoice->add(short_name.c_str());
+	}
+	if (CAudioDevice::IsFile(cfgout)) {
+		const std::string short_name(FileDeviceName(cfgout));
+		AudioOutMap[short_name] = std::pair<std::string, std::string>(cfgout, cfgout.substr(5));
+		outchoice = pAudioOutputChoice->add(short_name.c_str());
+	}
 	pAudioInputChoice->value(inchoice);
 	AudioInputChoice();
 	pAudioOutputChoice->value(outchoice);
@@ -61,13 +61,18 @@ private:
 #ifndef NO_DHT
 	Fl_Input *pBootstrapInput;
 #endif
-	Fl_Group *pStationGroup, *pAudioGroup, *pInternetGroup, *pCodecGroup;
+	Fl_Group *pStationGroup, *pAudioGroup, *pLatencyGroup, *pInternetGroup, *pCodecGroup;
 #ifndef NO_DHT
 	Fl_Group *pDHTGroup;
 #endif
 	Fl_Radio_Round_Button *pVoiceOnlyRadioButton, *pVoiceDataRadioButton;
 	Fl_Radio_Round_Button *pIPv4RadioButton, *pIPv6RadioButton, *pDualStackRadioButton;
 	Fl_Box *pAudioInputDescBox, *pAudioOutputDescBox;
+	Fl_Spinner *pInPeriodsSpinner, *pOutPeriodsSpinner, *pStartPeriodsSpinner;
+	Fl_Button *pAutoTuneButton;
+	Fl_Box *pAutoTuneBox;
+	std::string tunestatus;	// the label of pAutoTuneBox
+	int tunedin, tunedout;		// from the playback thread
 	// helpers
 	void SetOkayButton();
 	// Callback wrapper
@@ -80,6 +85,8 @@ private:
 	static void LatitudeInputCB(Fl_Widget *p, void *v);
 	static void LongitudeInputCB(Fl_Widget *p, void *v);
 	static void TextMessageInputCB(Fl_Widget *p, void *v);
+	static void AutoTuneButtonCB(Fl_Widget *p, void *v);
+	static void AutoTuneDoneCB(void *v);
 
 	// the actual callbacks
 	void SourceCallsignInput();
@@ -91,4 +98,6 @@ private:
 	void LatitudeInput();
 	void LongitudeInput();
 	void TextMessageInput();
+	void AutoTuneButton();
+	void AutoTuneDone();
 };
@@ -0,0 +1,146 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#include "StreamTable.h"
+
+void CStreamTable::Clear()
+{
+	for (auto &u : used)
+		u = false;
+	count = 0u;
+}
+
+// FNV-1a over the stream id, the port and the address
+unsigned CStreamTable::Hash(uint16_t sid, const CSockAddress &from)
+{
+	uint32_t h = 2166136261u;
+	auto mix = [&h](const void *p, size_t n) {
+		auto b = (const uint8_t *)p;
+		for (size_t i=0; i<n; i++)
+			h = (h ^ b[i]) * 16777619u;
+	};
+	mix(&sid, sizeof(sid));
+	const auto port = from.GetPort();
+	mix(&port, sizeof(port));
+	if (AF_INET6 == from.GetFamily())
+		mix(&((const struct sockaddr_in6 *)from.GetCPointer())->sin6_addr, sizeof(struct in6_addr));
+	else
+		mix(&((const struct sockaddr_in *)from.GetCPointer())->sin_addr, sizeof(struct in_addr));
+	return h & (SIZE - 1u);
+}
+
+bool CStreamTable::Same(const SStream &stream, uint16_t sid, const CSockAddress &from)
+{
+	// the address compare doesn't look at the port
+	return sid == stream.sid && from == stream.from && from.GetPort() == stream.from.GetPort();
+}
+
+SStream *CStreamTable::Find(uint16_t sid, const CSockAddress &from)
+{
+	for (unsigned i=Hash(sid, from); used[i]; i=(i+1u)&(SIZE-1u))
+	{
+		if (Same(slot[i], sid, from))
+			return &slot[i];
+	}
+	return nullptr;
+}
+
+SStream *CStreamTable::Insert(const CStreamFrame &first, const CSockAddress &from, int64_t now, int64_t due)
+{
+	if (count >= MAX_STREAMS)
+		return nullptr;
+	const auto sid = first.GetStreamId();
+	unsigned i = Hash(sid, from);
+	while (used[i])
+		i = (i + 1u) & (SIZE - 1u);
+	used[i] = true;
+	count++;
+	auto &s = slot[i];
+	s.sid = sid;
+	s.from = from;
+	if (0u == ++serial)
+		serial = 1u;
+	s.key = serial;
+	s.header.CopyFrom(first);
+	s.next = (first.GetFrameNumber() + 1u) & 0x7fffu;
+	s.start = now;
+	s.due = due;
+	s.stats.frames = 1u;
+	s.stats.lost = s.stats.late = 0u;
+	return &s;
+}
+
+void CStreamTable::Remove(SStream *stream)
+{
+	unsigned i = unsigned(stream - slot);
+	used[i] = false;
+	count--;
+	// move back anything that would have been put here, so a probe never stops too soon
+	for (unsigned j=(i+1u)&(SIZE-1u); used[j]; j=(j+1u)&(SIZE-1u))
+	{
+		const unsigned home = Hash(slot[j].sid, slot[j].from);
+		// it can move if its home isn't cyclically in (i, j]
+		if (((j - home) & (SIZE - 1u)) >= ((j - i) & (SIZE - 1u)))
+		{
+			slot[i] = slot[j];
+			used[i] = true;
+			used[j] = false;
+			i = j;
+		}
+	}
+}
+
+SStream *CStreamTable::Expired(int64_t now)
+{
+	for (unsigned i=0u; i<SIZE; i++)
+	{
+		if (used[i] && slot[i].due <= now)
+			return &slot[i];
+	}
+	return nullptr;
+}
+
+int64_t CStreamTable::NextDue() const
+{
+	int64_t due = 0;
+	for (unsigned i=0u; i<SIZE; i++)
+	{
+		if (used[i] && (0 == due || slot[i].due < due))
+			due = slot[i].due;
+	}
+	return due;
+}
+
+bool CStreamTable::Update(SStream &stream, const CStreamFrame &frame, int64_t due)
+{
+	const uint16_t fn = frame.GetFrameNumber();
+	// frame numbers are 15 bits, a jump of less than half way round is forward
+	const uint16_t ahead = (fn - stream.next) & 0x7fffu;
+	stream.stats.frames++;
+	if (ahead < 0x4000u)
+	{
+		stream.stats.lost += ahead;
+		stream.next = (fn + 1u) & 0x7fffu;
+		stream.header.CopyFrom(frame);
+	}
+	else
+		stream.stats.late++;
+	stream.due = due;
+	return 0u != (fn & 0x8000u);
+}
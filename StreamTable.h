@@ -0,0 +1,84 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+
+#include "Packet.h"
+#include "SockAddress.h"
+
+using SStreamStats = struct streamstats_tag
+{
+	unsigned int frames;	// that came in
+	unsigned int lost;		// frame numbers that were skipped over
+	unsigned int late;		// came in after a later frame, or more than once
+};
+
+// one stream coming in to the gateway
+using SStream = struct stream_tag
+{
+	uint16_t sid;
+	CSockAddress from;
+	uint32_t key;			// never zero, and no other stream has had it lately
+	CStreamFrame header;	// the last frame, a timed out stream is closed with a copy of it
+	uint16_t next;			// the frame number that should come next
+	int64_t start, due;		// steady clock, in nanoseconds
+	SStreamStats stats;
+};
+
+// The streams the gateway is receiving, keyed on the stream id and where it
+// came from, so two talkers on a reflector are kept apart. It's an open
+// addressed hash table with linear probing, and a removed stream's place is
+// filled by shifting back what comes after it, so there are no tombstones.
+// Everything is in one array, and it's only used on the gateway's thread.
+// Each stream also gets a key of its own, which goes on its frames, so the
+// audio manager can keep apart two streams that have the same stream id.
+class CStreamTable
+{
+public:
+	// at most half full, so a probe is short
+	static constexpr unsigned SIZE = 16u;
+	static constexpr unsigned MAX_STREAMS = SIZE / 2u;
+
+	CStreamTable() : serial(0u) { Clear(); }
+	void Clear();
+	// nullptr if it's not here
+	SStream *Find(uint16_t sid, const CSockAddress &from);
+	// nullptr if the table is full
+	SStream *Insert(const CStreamFrame &first, const CSockAddress &from, int64_t now, int64_t due);
+	// the pointer is no good after this, and neither are any others into the table
+	void Remove(SStream *stream);
+	unsigned Count() const { return count; }
+	// the first stream that was due at or before now, nullptr if none
+	SStream *Expired(int64_t now);
+	// the earliest due time, zero if the table is empty
+	int64_t NextDue() const;
+	// follows the frame number, returns true if it's the last frame
+	static bool Update(SStream &stream, const CStreamFrame &frame, int64_t due);
+
+private:
+	SStream slot[SIZE];
+	bool used[SIZE];
+	unsigned count;
+	uint32_t serial;	// the last key that was handed out
+
+	static unsigned Hash(uint16_t sid, const CSockAddress &from);
+	static bool Same(const SStream &stream, uint16_t sid, const CSockAddress &from);
+};
@@ -22,6 +22,10 @@
 #include <mutex>
 #include <condition_variable>
 #include <string>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <utility>
 
 template <class T> class CTQueue
 {
@@ -71,6 +75,85 @@ private:
 	std::condition_variable c;
 };
 
+// A bounded, lock-free multi-producer multi-consumer queue (Vyukov's ring).
+// Each cell has a sequence number that tells whose turn it is, so a push or
+// a pop is one compare-and-swap on the shared index and never waits on
+// another thread. N must be a power of two. Items are moved in and out, so a
+// cell never holds on to something it has already handed out.
+template <class T, size_t N> class CTBoundedQueue
+{
+	static_assert(N >= 2 && 0 == (N & (N - 1)), "the size must be a power of two");
+public:
+	CTBoundedQueue()
+	{
+		for (size_t i=0; i<N; i++)
+			cell[i].seq.store(i, std::memory_order_relaxed);
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+	// returns true if the queue is full
+	bool Push(T item)
+	{
+		size_t pos = tail.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			SCell &c = cell[pos & (N - 1)];
+			const size_t seq = c.seq.load(std::memory_order_acquire);
+			const intptr_t dif = intptr_t(seq) - intptr_t(pos);
+			if (0 == dif)
+			{
+				if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					c.item = std::move(item);
+					c.seq.store(pos + 1, std::memory_order_release);
+					return false;
+				}
+			}
+			else if (dif < 0)
+				return true;
+			else
+				pos = tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	// returns true if the queue is empty
+	bool Pop(T &item)
+	{
+		size_t pos = head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			SCell &c = cell[pos & (N - 1)];
+			const size_t seq = c.seq.load(std::memory_order_acquire);
+			const intptr_t dif = intptr_t(seq) - intptr_t(pos + 1);
+			if (0 == dif)
+			{
+				if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					item = std::move(c.item);
+					c.seq.store(pos + N, std::memory_order_release);
+					return false;
+				}
+			}
+			else if (dif < 0)
+				return true;
+			else
+				pos = head.load(std::memory_order_relaxed);
+		}
+	}
+
+private:
+	using SCell = struct cell_tag
+	{
+		std::atomic<size_t> seq;
+		T item;
+	};
+	SCell cell[N];
+	// the producers and the consumers each get their own cache line
+	alignas(64) std::atomic<size_t> tail;
+	alignas(64) std::atomic<size_t> head;
+};
+
 template <class T, int N> class CTFrame
 {
 public:
@@ -78,24 +161,30 @@ public:
 	{
 		memset(data, 0, N * sizeof(T));
 		flag = false;
+		origin = stamp = 0;
 	}
 
 	CTFrame(const T *from)
 	{
 		memcpy(data, from, N * sizeof(T));
 		flag = false;
+		origin = stamp = 0;
 	}
 
 	CTFrame(const CTFrame<T, N> &from)
 	{
 		memcpy(data, from.GetData(), N *sizeof(T));
 		flag = from.GetFlag();
+		origin = from.GetOrigin();
+		stamp = from.GetStamp();
 	}
 
 	CTFrame<T, N> &operator=(const CTFrame<T, N> &from)
 	{
 		memcpy(data, from.GetData(), N * sizeof(T));
 		flag = from.GetFlag();
+		origin = from.GetOrigin();
+		stamp = from.GetStamp();
 		return *this;
 	}
 
@@ -119,9 +208,27 @@ public:
 		flag = s;
 	}
 
+	// latency timestamps: when the frame entered the pipeline and when it left the last stage
+	int64_t GetOrigin() const
+	{
+		return origin;
+	}
+
+	int64_t GetStamp() const
+	{
+		return stamp;
+	}
+
+	void SetStamps(int64_t o, int64_t s)
+	{
+		origin = o;
+		stamp = s;
+	}
+
 private:
 	T data[N];
 	bool flag;
+	int64_t origin, stamp;
 };
 
 // audio
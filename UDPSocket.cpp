@@ -100,6 +100,16 @@ bool CUDPSocket::Open(const CSockAddress &addr)
 	return false;
 }
 
+bool CUDPSocket::Connect(const CSockAddress &addr)
+{
+	if (connect(m_fd, addr.GetCPointer(), addr.GetSize()))
+	{
+		std::cerr << "connect failed on " << m_addr << " to " << addr << ", " << strerror(errno) << std::endl;
+		return true;
+	}
+	return false;
+}
+
 void CUDPSocket::Close(void)
 {
 	if ( m_fd >= 0 )
@@ -30,6 +30,8 @@ public:
 	~CUDPSocket();
 
 	bool Open(const CSockAddress &addr);
+	// only datagrams from here will be received, and send() doesn't need an address, returns true on failure
+	bool Connect(const CSockAddress &addr);
 	void Close(void);
 
 	int GetSocket(void) const { return m_fd; }
@@ -20,10 +20,9 @@
 #include <unistd.h>
 #include <string.h>
 #include <cstring>
-#include <thread>
-#include <chrono>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
@@ -82,55 +81,97 @@ int CUnixDgramReader::GetFD()
 	return fd;
 }
 
-CUnixDgramWriter::CUnixDgramWriter() {}
+CUnixDgramWriter::CUnixDgramWriter() : policy(EWritePolicy::drop), timeout(10), fd(-1), dropped(0), unreported(0)
+{
+	memset(&addr, 0, sizeof(addr));
+}
 
-CUnixDgramWriter::~CUnixDgramWriter() {}
+CUnixDgramWriter::~CUnixDgramWriter()
+{
+	Close();
+}
 
-void CUnixDgramWriter::SetUp(const char *path)	// returns true on failure
+void CUnixDgramWriter::SetUp(const char *path, EWritePolicy p, int timeout_ms)
 {
+	Close();
 	// setup the socket address
 	memset(&addr, 0, sizeof(addr));
 	addr.sun_family = AF_UNIX;
 	strncpy(addr.sun_path+1, path, sizeof(addr.sun_path)-2);
+	policy = p;
+	timeout = timeout_ms;
 }
 
-ssize_t CUnixDgramWriter::Write(const void *buf, size_t size)
+void CUnixDgramWriter::Close()
 {
-	// open the socket
-	int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-	if (fd < 0) {
+	const int old = fd.exchange(-1);
+	if (old >= 0)
+		close(old);
+}
+
+// returns the connected socket, or -1 if there's no reader yet
+int CUnixDgramWriter::Connect()
+{
+	int s = fd;
+	if (s >= 0)
+		return s;
+	s = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (s < 0) {
 		fprintf(stderr, "Failed to open socket %s : %s\n", addr.sun_path+1, strerror(errno));
 		return -1;
 	}
-	// connect to the receiver
-	int rval = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
-	if (rval < 0) {
+	if (connect(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
 		fprintf(stderr, "Failed to connect to socket %s : %s\n", addr.sun_path+1, strerror(errno));
-		close(fd);
+		close(s);
 		return -1;
 	}
+	// another thread may have beaten us to it
+	int expected = -1;
+	if (! fd.compare_exchange_strong(expected, s)) {
+		close(s);
+		return expected;
+	}
+	return s;
+}
 
-	ssize_t written = 0;
-	int count = 0;
-	while (written <= 0) {
-		written = write(fd, buf, size);
-		if (written == (ssize_t)size)
-			break;
-		else if (written < 0)
-			fprintf(stderr, "ERROR: faied to write to %s : %s\n", addr.sun_path+1, strerror(errno));
-		else if (written == 0)
-			fprintf(stderr, "Warning: zero bytes written to %s\n", addr.sun_path+1);
-		else if (written != (ssize_t)size) {
-			fprintf(stderr, "ERROR: only %d of %d bytes written to %s\n", (int)written, (int)size, addr.sun_path+1);
-			break;
-		}
-		if (++count >= 100) {
-			fprintf(stderr, "ERROR: Write failed after %d attempts\n", count-1);
-			break;
-		}
-		std::this_thread::sleep_for(std::chrono::microseconds(5));
+void CUnixDgramWriter::Drop()
+{
+	dropped++;
+	unreported++;
+}
+
+ssize_t CUnixDgramWriter::Write(const void *buf, size_t size)
+{
+	const int s = Connect();
+	if (s < 0) {
+		Drop();
+		return -1;
 	}
 
-	close(fd);
+	ssize_t written = write(s, buf, size);
+	if (written < 0 && (ECONNREFUSED == errno || ENOTCONN == errno || EDESTADDRREQ == errno)) {
+		// the reader went away, try again in case it's back
+		if (0 == connect(s, (struct sockaddr *)&addr, sizeof(addr)))
+			written = write(s, buf, size);
+	}
+	if (written < 0 && (EAGAIN == errno || EWOULDBLOCK == errno) && EWritePolicy::wait == policy) {
+		// wait for the reader to make room, but not for long
+		struct pollfd pfd = { s, POLLOUT, 0 };
+		if (poll(&pfd, 1, timeout) > 0)
+			written = write(s, buf, size);
+	}
+
+	if (written == (ssize_t)size) {
+		const auto count = unreported.exchange(0);
+		if (count)
+			fprintf(stderr, "%lu messages to %s were dropped\n", count, addr.sun_path+1);
+	} else if (written < 0) {
+		Drop();
+		if (EAGAIN != errno && EWOULDBLOCK != errno && ECONNREFUSED != errno && ENOTCONN != errno && EDESTADDRREQ != errno) {
+			fprintf(stderr, "ERROR: failed to write to %s : %s\n", addr.sun_path+1, strerror(errno));
+		}
+	} else {
+		fprintf(stderr, "ERROR: only %d of %d bytes written to %s\n", (int)written, (int)size, addr.sun_path+1);
+	}
 	return written;
 }
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <string>
+#include <atomic>
 #include <stdlib.h>
 #include <sys/un.h>
 
@@ -34,14 +35,30 @@ private:
 	int fd;
 };
 
+// what Write() does when the reader isn't keeping up
+enum class EWritePolicy { drop, wait };
+
+// One connected, non-blocking socket is kept open and shared by every thread
+// that writes, so a message is a single write(). If the reader's queue is
+// full, the message is dropped, or with EWritePolicy::wait, it waits up to
+// the timeout for room first. Dropped messages are counted.
 class CUnixDgramWriter
 {
 public:
 	CUnixDgramWriter();
 	~CUnixDgramWriter();
-	void SetUp(const char *path);
+	void SetUp(const char *path, EWritePolicy policy = EWritePolicy::drop, int timeout_ms = 10);
 	ssize_t Write(const void *buf, size_t size);
 	ssize_t Write(const std::string &s) { return Write(s.c_str(), s.size()); }
+	void Close();
+	unsigned long GetDropped() const { return dropped; }
 private:
 	struct sockaddr_un addr;
+	EWritePolicy policy;
+	int timeout;
+	std::atomic<int> fd;
+	std::atomic<unsigned long> dropped, unreported;
+
+	int Connect();
+	void Drop();
 };
@@ -0,0 +1,94 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include <FL/fl_draw.H>
+
+#include "VUMeter.h"
+
+#define FLOOR_DB -60.0
+// in dB per update, about 20 dB per second
+#define FALL_DB 1.0
+// updates to hold the peak, about one and a half seconds
+#define HOLD_COUNT 30
+
+CVUMeter::CVUMeter(int X, int Y, int W, int H, const char *L) : Fl_Widget(X, Y, W, H, L), level(FLOOR_DB), hold(FLOOR_DB), hold_count(0)
+{
+	box(FL_DOWN_BOX);
+}
+
+void CVUMeter::Set(double rms, double peak)
+{
+	const double r = (rms > 0.0) ? 20.0 * log10(rms / 32768.0) : FLOOR_DB;
+	const double p = (peak > 0.0) ? 20.0 * log10(peak / 32768.0) : FLOOR_DB;
+	// jump up right away, fall back slowly, like a real meter
+	level = (r > level) ? r : std::max(r, level - FALL_DB);
+	if (p >= hold) {
+		hold = p;
+		hold_count = HOLD_COUNT;
+	} else if (hold_count > 0) {
+		hold_count--;
+	} else {
+		hold = std::max(FLOOR_DB, hold - FALL_DB);
+	}
+	redraw();
+}
+
+void CVUMeter::Idle()
+{
+	if (level > FLOOR_DB || hold > FLOOR_DB)
+		Set(0.0, 0.0);
+}
+
+int CVUMeter::Position(double db) const
+{
+	if (db < FLOOR_DB)
+		db = FLOOR_DB;
+	else if (db > 0.0)
+		db = 0.0;
+	const int inside = w() - Fl::box_dw(box());
+	return int(inside * (db - FLOOR_DB) / -FLOOR_DB);
+}
+
+void CVUMeter::draw()
+{
+	draw_box();
+	const int X = x() + Fl::box_dx(box());
+	const int Y = y() + Fl::box_dy(box());
+	const int H = h() - Fl::box_dh(box());
+	const int W = Position(level);
+	// green up to -18 dBFS, yellow to -6 dBFS, then red
+	const int yellow = Position(-18.0), red = Position(-6.0);
+	fl_color(FL_GREEN);
+	fl_rectf(X, Y, std::min(W, yellow), H);
+	if (W > yellow) {
+		fl_color(FL_YELLOW);
+		fl_rectf(X + yellow, Y, std::min(W, red) - yellow, H);
+	}
+	if (W > red) {
+		fl_color(FL_RED);
+		fl_rectf(X + red, Y, W - red, H);
+	}
+	if (hold > FLOOR_DB) {
+		fl_color(FL_BLACK);
+		const int P = X + Position(hold);
+		fl_yxline(std::max(X, P - 1), Y, Y + H - 1);
+	}
+}
@@ -0,0 +1,43 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include "FLTK-GUI.h"
+
+// A horizontal level bar with a peak hold marker, from -60 to 0 dBFS.
+// The main window hands it a level about 20 times a second.
+class CVUMeter : public Fl_Widget
+{
+public:
+	CVUMeter(int X, int Y, int W, int H, const char *L = 0);
+	~CVUMeter() {}
+
+	// rms and peak are linear, where full scale is 32768, and they decay when nothing is flowing
+	void Set(double rms, double peak);
+	void Idle();
+
+protected:
+	void draw();
+
+private:
+	double level, hold;	// dBFS
+	int hold_count;
+
+	int Position(double db) const;
+};
@@ -0,0 +1,160 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <pthread.h>
+#include <cstring>
+#include <iostream>
+
+#include "Worker.h"
+
+CWorker::CWorker() : busy(false), quit(false) {}
+
+CWorker::~CWorker()
+{
+	Stop();
+}
+
+bool CWorker::Start(const std::string &n, ERTPolicy policy, int priority, int cpu)
+{
+	if (thread.joinable())
+		return false;	// already running
+	name.assign(n);
+	quit = busy = false;
+	wakeup.Clear();
+	try {
+		thread = std::thread(&CWorker::Loop, this);
+	} catch (const std::system_error &e) {
+		std::cerr << "Could not start the " << name << " thread: " << e.what() << std::endl;
+		return true;
+	}
+	// a failure here isn't fatal, the thread just runs with the default scheduling
+	SetScheduling(thread.native_handle(), name, policy, priority, cpu);
+	return false;
+}
+
+bool CWorker::SetScheduling(pthread_t handle, const std::string &name, ERTPolicy policy, int priority, int cpu)
+{
+	bool rval = false;
+	// thread names are limited to 15 characters
+	pthread_setname_np(handle, name.substr(0, 15).c_str());
+	if (ERTPolicy::none != policy)
+	{
+		const int pol = (ERTPolicy::fifo == policy) ? SCHED_FIFO : SCHED_RR;
+		const int min = sched_get_priority_min(pol);
+		const int max = sched_get_priority_max(pol);
+		if (priority < min)
+			priority = min;
+		else if (priority > max)
+			priority = max;
+		sched_param param;
+		param.sched_priority = priority;
+		auto err = pthread_setschedparam(handle, pol, &param);
+		if (err)
+		{
+			// usually EPERM, we need CAP_SYS_NICE or an rtprio limit in /etc/security/limits.conf
+			std::cerr << "Could not set real-time priority " << priority << " for the " << name << " thread: " << strerror(err) << std::endl;
+			rval = true;
+		}
+		else
+			std::cout << "The " << name << " thread is running at real-time priority " << priority << std::endl;
+	}
+	if (cpu >= 0)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		auto err = pthread_setaffinity_np(handle, sizeof(set), &set);
+		if (err)
+		{
+			std::cerr << "Could not pin the " << name << " thread to cpu " << cpu << ": " << strerror(err) << std::endl;
+			rval = true;
+		}
+	}
+	return rval;
+}
+
+void CWorker::Stop()
+{
+	if (thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lck(mtx);
+			quit = true;
+			cv.notify_all();
+		}
+		thread.join();
+	}
+}
+
+bool CWorker::Run(std::function<void()> func)
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	if (job)
+	{
+		std::cerr << "The " << name << " thread already has a job waiting!" << std::endl;
+		return true;
+	}
+	job = std::move(func);
+	busy = true;
+	posted = std::chrono::steady_clock::now();
+	cv.notify_all();
+	return false;
+}
+
+void CWorker::Wait()
+{
+	std::unique_lock<std::mutex> lck(mtx);
+	cv.wait(lck, [this]{ return ! busy; });
+}
+
+bool CWorker::IsBusy()
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	return busy;
+}
+
+SWakeupStats CWorker::GetWakeupStats()
+{
+	std::lock_guard<std::mutex> lck(mtx);
+	auto rval = wakeup;
+	wakeup.Clear();
+	return rval;
+}
+
+void CWorker::Loop()
+{
+	std::unique_lock<std::mutex> lck(mtx);
+	while (true)
+	{
+		cv.wait(lck, [this]{ return quit || job; });
+		if (quit)
+			break;
+		const std::chrono::duration<double, std::micro> latency(std::chrono::steady_clock::now() - posted);
+		wakeup.Add(latency.count());
+		auto func = std::move(job);
+		job = nullptr;
+		lck.unlock();
+		func();
+		lck.lock();
+		if (! job)
+		{
+			busy = false;
+			cv.notify_all();
+		}
+	}
+}
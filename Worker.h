@@ -0,0 +1,76 @@
+/*
+ *   Copyright (c) 2026 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+#include <string>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+#include "Configure.h"
+
+// wake-up latency bookkeeping, in microseconds
+using SWakeupStats = struct wakeupstats_tag
+{
+	unsigned int count;
+	double sum, max;
+
+	void Clear() { count = 0u; sum = max = 0.0; }
+	void Add(double us) { count++; sum += us; if (us > max) max = us; }
+	double Average() const { return count ? sum / count : 0.0; }
+};
+
+// A long-lived thread for one stage of the audio pipeline.
+// The thread is created once by Start() and then sits idle until it is
+// handed a job with Run(). Wait() blocks until that job has returned.
+// One more job can be queued while a job is running, even by the job itself.
+class CWorker
+{
+public:
+	CWorker();
+	~CWorker();
+	// returns true on failure
+	bool Start(const std::string &name, ERTPolicy policy = ERTPolicy::none, int priority = 0, int cpu = -1);
+	void Stop();
+	// returns true if there is already a job waiting to run
+	bool Run(std::function<void()> func);
+	void Wait();
+	bool IsBusy();
+	// how long the thread took to pick up its jobs since the last call
+	SWakeupStats GetWakeupStats();
+
+	// can be used on any thread, returns true if something couldn't be set
+	static bool SetScheduling(pthread_t handle, const std::string &name, ERTPolicy policy, int priority, int cpu);
+
+private:
+	std::string name;
+	std::thread thread;
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::function<void()> job;
+	bool busy, quit;
+	std::chrono::steady_clock::time_point posted;
+	SWakeupStats wakeup;
+
+	void Loop();
+};
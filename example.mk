@@ -19,6 +19,12 @@ DEBUG = false
 # Otherwise, set this to true.
 USE44100 = false
 
+# The gateway can do its network I/O with io_uring instead of epoll.
+# This needs liburing and a 6.0 or newer kernel, and then it's turned on
+# with GatewayIOUring=true in mvoice.cfg. "make iobench" builds a program
+# that compares the packet rate of the two.
+USE_IO_URING = false
+
 # By default, mvoice uses the Ham-DHT network, a "distributed hash table" network.
 # The Ham-DHT will provide addtional information about reflectors, making it easier to use them.
 # if you don't want this, set this to false.